@@ -0,0 +1,108 @@
+/* Description: A single preprocessing pass over an edge-detected image. Row
+ * strips of the image are scanned in parallel, and each pixel is read once
+ * to find the rectangle that trims the image to its edges, the edge count,
+ * the edge density and the number of edges in every row and column. */
+#include "edgeStats.h"
+#include <algorithm>
+
+/* Purpose: To trim an edge-detected image and measure its edges in one pass.
+ * Pre-conditions: image is a single channel edge-detected image.
+ * Post-conditions: Returns the crop that runs from the first edge row (col) up
+ *          to, but not including, the last edge row (col), and the edge
+ *          statistics of the image inside that crop. */
+EdgeStats computeEdgeStats(const Mat &image, int edgeValue) {
+  EdgeStats stats;
+  int rows = image.rows;
+  int cols = image.cols;
+  if (rows == 0 || cols == 0) {
+    return stats;
+  }
+
+  /* Give every thread a few strips of rows. Each strip writes the counts of
+   * its own rows and keeps its own column counts, so no counts are shared
+   * between threads: */
+  int strips = min(rows, max(1, getNumThreads()) * 4);
+  vector<int> rowCounts(rows, 0);
+  vector<vector<int>> stripColCounts(strips, vector<int>(cols, 0));
+  parallel_for_(Range(0, strips), [&](const Range &range) {
+    for (int strip = range.start; strip < range.end; ++strip) {
+      int *colCounts = stripColCounts[strip].data();
+      int firstRow = static_cast<int>(static_cast<long long>(strip) * rows /
+                                      strips);
+      int lastRow = static_cast<int>(static_cast<long long>(strip + 1) *
+                                     rows / strips);
+      for (int row = firstRow; row < lastRow; ++row) {
+        /* Count without branching, so the compiler can vectorize the loop:
+         */
+        const uchar *pixels = image.ptr<uchar>(row);
+        int count = 0;
+        for (int col = 0; col < cols; ++col) {
+          int isEdge = pixels[col] == edgeValue;
+          colCounts[col] += isEdge;
+          count += isEdge;
+        }
+        rowCounts[row] = count;
+      }
+    }
+  });
+
+  /* Merge the column counts of the strips: */
+  vector<int> colCounts(cols, 0);
+  for (const vector<int> &counts : stripColCounts) {
+    for (int col = 0; col < cols; ++col) {
+      colCounts[col] += counts[col];
+    }
+  }
+
+  /* The first and last rows (cols) with an edge bound the edges: */
+  int leastRow = 0;
+  while (leastRow < rows && rowCounts[leastRow] == 0) {
+    leastRow++;
+  }
+  if (leastRow == rows) {
+    /* Without edges the crop is empty, as it always has been: */
+    return stats;
+  }
+  int greatestRow = rows - 1;
+  while (rowCounts[greatestRow] == 0) {
+    greatestRow--;
+  }
+  int leastCol = 0;
+  while (colCounts[leastCol] == 0) {
+    leastCol++;
+  }
+  int greatestCol = cols - 1;
+  while (colCounts[greatestCol] == 0) {
+    greatestCol--;
+  }
+
+  /* The crop leaves out the last edge row and col: */
+  stats.crop = Rect(leastCol, leastRow, greatestCol - leastCol,
+                    greatestRow - leastRow);
+  stats.rowEdges.assign(rowCounts.begin() + leastRow,
+                        rowCounts.begin() + greatestRow);
+  stats.colEdges.assign(colCounts.begin() + leastCol,
+                        colCounts.begin() + greatestCol);
+
+  /* Every edge is between the least and greatest col, so a row keeps all of
+   * its edges except one in the greatest col (and likewise for a col): */
+  for (int row = leastRow; row < greatestRow; ++row) {
+    if (image.ptr<uchar>(row)[greatestCol] == edgeValue) {
+      stats.rowEdges[row - leastRow]--;
+    }
+  }
+  const uchar *lastRow = image.ptr<uchar>(greatestRow);
+  for (int col = leastCol; col < greatestCol; ++col) {
+    if (lastRow[col] == edgeValue) {
+      stats.colEdges[col - leastCol]--;
+    }
+  }
+
+  for (int count : stats.rowEdges) {
+    stats.edges += count;
+  }
+  if (stats.crop.area() > 0) {
+    stats.density = stats.edges / static_cast<double>(stats.crop.area());
+  }
+  return stats;
+}
@@ -0,0 +1,29 @@
+/* Description: A single preprocessing pass over an edge-detected image. Row
+ * strips of the image are scanned in parallel, and each pixel is read once
+ * to find the rectangle that trims the image to its edges, the edge count,
+ * the edge density and the number of edges in every row and column. */
+#pragma once
+#include <opencv2/core.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+/* Structure that stores the statistics of a trimmed edge-detected image: */
+struct EdgeStats {
+  /* Rectangle that trims the image to its edges: */
+  Rect crop;
+  /* Number of edges inside crop, and the ratio of edges to pixels: */
+  int edges = 0;
+  double density = 0;
+  /* Number of edges in every row and column of crop: */
+  vector<int> rowEdges;
+  vector<int> colEdges;
+};
+
+/* Purpose: To trim an edge-detected image and measure its edges in one pass.
+ * Pre-conditions: image is a single channel edge-detected image.
+ * Post-conditions: Returns the crop that runs from the first edge row (col) up
+ *          to, but not including, the last edge row (col), and the edge
+ *          statistics of the image inside that crop. */
+EdgeStats computeEdgeStats(const Mat &image, int edgeValue);
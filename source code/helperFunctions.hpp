@@ -5,10 +5,12 @@
  * detection, so that the exemplar and search images are ready for object
  * recognition. */
 #include "objectRecognition.h"
+#include <fstream>
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
+#include <sstream>
 
 using namespace cv;
 using namespace std;
@@ -24,6 +26,15 @@ const pair<double, double> sigma = make_pair(2, 2);
 const int maxThresholdDev = 30;
 const int minThresholdDev = 60;
 
+/* Structure that stores an edge-detected image and its label: */
+struct LabelledImage {
+  string name;
+  bool mask;
+  Mat edges;
+  Mat original;
+  EdgeStats stats;
+};
+
 /* Purpose: To perform edge detection on an image.
  * Pre-conditions: Parameters are valid.
  * Post-conditions: Changes the color image to an edge-detected image and
@@ -72,67 +83,63 @@ void readImage(Mat &image, string imageType) {
 }
 
 /* Purpose: Read in an input image and trims sides for minimum image size with
- * maximum edges Pre-conditions: input is valid (e.g., not .gif).
- * Post-conditions: Transforms image by trimming sides */
-void trimImage(Mat &input, Mat &original) {
-  /* Save row and col dimensions: */
-  bool foundFirstEdge = false;
-  int leastRow = 0;
-  int greatestRow = 0;
-  int leastCol = 0;
-  int greatestCol = 0;
-
-  /* Iterate through image to find these values: */
-  for (int row = 0; row < input.rows; ++row) {
-    for (int col = 0; col < input.cols; ++col) {
-      /* Check if edge: */
-      if (input.at<uchar>(row, col) == edge) {
-        /* Set first edge to be where the "rectangle of edges" begins: */
-        if (!foundFirstEdge) {
-          leastRow = row;
-          leastCol = col;
-          greatestRow = row;
-          greatestCol = col;
-          foundFirstEdge = true;
-        } else {
-          /* Check if even lesser: */
-          if (row < leastRow) {
-            /* Set row: */
-            leastRow = row;
-          }
-          if (col < leastCol) {
-            /* Set col: */
-            leastCol = col;
-          }
-          /* Check if greater: */
-          if (row > greatestRow) {
-            /* Set row: */
-            greatestRow = row;
-          }
-          if (col > greatestCol) {
-            /* Set col: */
-            greatestCol = col;
-          }
-        }
-      }
+ * maximum edges.
+ * Pre-conditions: input is valid (e.g., not .gif).
+ * Post-conditions: Transforms image by trimming sides. Returns the edge
+ *            statistics of the trimmed image. */
+EdgeStats trimImage(Mat &input, Mat &original) {
+  /* Find the "rectangle of edges" and measure the edges in one pass: */
+  EdgeStats stats = computeEdgeStats(input, edge);
+
+  /* Crop using opencv: */
+  input = input(stats.crop);
+  original = original(stats.crop);
+
+  return stats;
+}
+
+/* Purpose: To read in and edge-detect every image of a labels file.
+ * Pre-conditions: Every image named in the labels file is in directory.
+ * Post-conditions: Returns the cropped edge-detected images with labels. */
+vector<LabelledImage> readLabelledImages(const string &directory,
+                                         const string &labelsFile) {
+  vector<LabelledImage> images;
+  ifstream labels(labelsFile);
+  string line;
+  while (getline(labels, line)) {
+    istringstream fields(line);
+    LabelledImage image;
+    int mask = 0;
+    if (!(fields >> image.name >> mask)) {
+      continue;
     }
+    image.mask = mask != 0;
+    image.original = imread(directory + "/" + image.name);
+    if (image.original.empty()) {
+      cout << "Could not read " + image.name << endl;
+      continue;
+    }
+    image.edges = image.original.clone();
+    readImage(image.edges, image.name);
+    image.stats = trimImage(image.edges, image.original);
+    images.push_back(image);
   }
+  return images;
+}
 
-  /* Set the image and crop using opencv: */
-  cv::Rect newDim(leastCol, leastRow, greatestCol - leastCol,
-                  greatestRow - leastRow);
-
-  input = input(newDim);
-
-  /* Print out new cropped image: */
-  namedWindow("Cropped Image");
-  imshow("Cropped Image", input);
-  waitKey(0);
-
-  original = original(newDim);
-
-  /* Print out new cropped image: */
-  namedWindow("Original Cropped Image");
-  imshow("Original Cropped Image", original);
-  waitKey(0);
-}
\ No newline at end of file
+/* Purpose: To read in, edge-detect and crop an exemplar.
+ * Pre-conditions: None.
+ * Post-conditions: Sets edgedEx to the cropped edge-detected exemplar and
+ *            originalEx to the same crop of the original. Returns false if
+ *            the file cannot be read. */
+bool loadExemplar(const string &exemplarFile, Mat &edgedEx, Mat &originalEx) {
+  originalEx = imread(exemplarFile);
+  if (originalEx.empty()) {
+    cout << "Could not read exemplar " + exemplarFile << endl;
+    return false;
+  }
+  edgedEx = originalEx.clone();
+  readImage(edgedEx, "Exemplar Image");
+  trimImage(edgedEx, originalEx);
+  return true;
+}
@@ -26,6 +26,45 @@ int main(int argc, char *argv[]) {
   /* Testing done to show false negatives, false positives, and/or incorrect
    * output images: */
   cottonMaskFVIncorrectResults();
+  cout << endl;
+  /* Call test function that probes coarse levels with fewer points: */
+  cottonMaskSparseProbeTestFV();
+  cout << endl;
+  /* Call test function that matches with gradient orientations: */
+  cottonMaskOrientationTestFV();
+  cout << endl;
+  /* Call test function that rejects images before edge matching: */
+  cottonMaskRejectionTestFV();
+  cout << endl;
+  /* Call test function that skips translations that cannot match: */
+  cottonMaskCandidatePruningTestFV();
+  cout << endl;
+  /* Call test function that rejects invalid search profiles: */
+  searchProfileValidationTest();
+  cout << endl;
+  /* Call test function that bounds the time spent searching: */
+  cottonMaskLatencyBudgetTestFV();
+  cout << endl;
+  /* Call test function that reuses one object for a blank image: */
+  cottonMaskReuseTestFV();
+  cout << endl;
+  /* Call test function that samples the background result writer: */
+  resultWriterSamplingTest();
+  cout << endl;
+  /* Call test function that finds every detection in an image: */
+  cottonMaskMultiDetectionTestFV();
+  cout << endl;
+  /* Call test function that reuses results of repeated frames: */
+  cottonMaskResultCacheTestFV();
+  cout << endl;
+  /* Call test function that picks the cheapest translation strategy: */
+  cottonMaskStrategySelectorTestFV();
+  cout << endl;
+  /* Call test function that scores with every matcher backend: */
+  cottonMaskMatcherBackendTestFV();
+  cout << endl;
+  /* Call test function that trims and measures images in one pass: */
+  edgeStatsTest();
 
   return 0;
 }
\ No newline at end of file
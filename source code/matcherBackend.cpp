@@ -0,0 +1,226 @@
+/* Description: The scoring stage of object recognition behind an interface,
+ * so faster scoring kernels can be swapped in at runtime and compared against
+ * the original one. A backend prepares whatever it needs from a search image
+ * once, then counts how many points of a transformed exemplar land within one
+ * pixel of an edge. The "reference" backend is the original scoring code. */
+#include "matcherBackend.h"
+#include "simdBackend.h"
+#include "specializedBackend.h"
+
+/* Purpose: To create a backend by name.
+ * Pre-conditions: None.
+ * Post-conditions: Returns a new backend the caller owns, or nullptr if there
+ *          is no backend with that name. */
+MatcherBackend *createMatcherBackend(const string &name) {
+  if (name == "reference") {
+    return new ReferenceBackend();
+  }
+  if (name == "dilated") {
+    return new DilatedBackend();
+  }
+  if (name == "specialized") {
+    return new SpecializedBackend<1>();
+  }
+  if (name == "simd") {
+    return new SimdBackend();
+  }
+  return nullptr;
+}
+
+/* Purpose: To list the backends createMatcherBackend() knows.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the name of every backend. */
+vector<string> matcherBackendNames() {
+  return {"reference", "dilated", "specialized", "simd"};
+}
+
+/* Purpose: To dilate the edges of a search image into a padded map.
+ * Pre-conditions: searchImage is an edge-detected image and extraRows is at
+ *          least 0.
+ * Post-conditions: dilated is (rows + 2 + extraRows) x (cols + 2) and holds 1
+ *          at every padded (row + 1, col + 1) within one pixel of an edge, and
+ *          0 elsewhere. */
+void dilateEdges(const Mat &searchImage, int edgeValue, int extraRows,
+                 Mat &dilated) {
+  dilated.create(searchImage.rows + 2 + extraRows, searchImage.cols + 2,
+                 CV_8UC1);
+  dilated.setTo(Scalar(0));
+
+  /* Spread every edge over the 3x3 neighbourhood around it. An edge at
+   * (row, col) sits at (row + 1, col + 1) in the padded map: */
+  for (int row = 0; row < searchImage.rows; ++row) {
+    const uchar *source = searchImage.ptr<uchar>(row);
+    for (int col = 0; col < searchImage.cols; ++col) {
+      if (source[col] != edgeValue) {
+        continue;
+      }
+      for (int rowPlus = 0; rowPlus <= 2; ++rowPlus) {
+        uchar *target = dilated.ptr<uchar>(row + rowPlus) + col;
+        target[0] = 1;
+        target[1] = 1;
+        target[2] = 1;
+      }
+    }
+  }
+}
+
+/* REFERENCE BACKEND */
+
+/* Purpose: Constructor to create an unprepared backend.
+ * Pre-conditions: None.
+ * Post-conditions: Creates a backend with no search image. */
+ReferenceBackend::ReferenceBackend()
+    : searchImage(nullptr), edgeValue(255), sparseMap(nullptr) {}
+
+/* Purpose: To get the name the backend is created with.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the name of the backend. */
+string ReferenceBackend::name() const { return "reference"; }
+
+/* Purpose: To get whether the backend answers from the spatial hash.
+ * Pre-conditions: None.
+ * Post-conditions: Returns true: score() queries sparseMap when there is
+ *          one. */
+bool ReferenceBackend::usesSparseMap() const { return true; }
+
+/* Purpose: To prepare the backend for a search image.
+ * Pre-conditions: searchImage is an edge-detected image that outlives the
+ *          calls to score(). sparseMap is its spatial hash, or nullptr.
+ * Post-conditions: The backend can score transformations on the image. */
+void ReferenceBackend::prepare(const Mat &searchImage, int edgeValue,
+                               const SparseEdgeMap *sparseMap) {
+  this->searchImage = &searchImage;
+  this->edgeValue = edgeValue;
+  this->sparseMap = sparseMap;
+}
+
+/* Purpose: To count the edge matches of a transformed exemplar.
+ * Pre-conditions: prepare() has been called. points are (col, row).
+ * Post-conditions: Returns how many points, rotated by rotation degrees,
+ *          scaled and placed at origin (row, col), are within one pixel of an
+ *          edge. */
+int ReferenceBackend::score(const vector<Point> &points,
+                            pair<double, double> scale, int rotation,
+                            pair<int, int> origin) const {
+  int count = 0;
+
+  /* Convert degrees to radians and find the cos and sin values once for the
+   * whole transformation: */
+  const double pi = 3.14159265;
+  double cosVal = cos(rotation * (pi / 180));
+  double sinVal = sin(rotation * (pi / 180));
+
+  /* Iterate through the exemplar edge points: */
+  for (const Point &point : points) {
+    int rowEx = point.y;
+    int colEx = point.x;
+
+    /* Perform the rotation transformation: */
+    double newRow = (sinVal * colEx) + (cosVal * rowEx);
+    double newCol = (cosVal * colEx) + (-sinVal * rowEx);
+
+    /* Perform the scale transformation: */
+    newRow = static_cast<double>(newRow * scale.second);
+    newCol = static_cast<double>(newCol * scale.first);
+
+    /* Set the exemplar point with respect to origin: */
+    newRow += static_cast<double>(origin.first);
+    newCol += static_cast<double>(origin.second);
+
+    /* Check if edge: */
+    if (checkNeighbors(newRow, newCol)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/* Purpose: To check the neighbors of a given (row, col) to see if edge.
+ * Pre-conditions: None.
+ * Post-conditions: Returns true if an edge exists.  */
+bool ReferenceBackend::checkNeighbors(double row, double col) const {
+  /* New row and cols: */
+  int newRow = static_cast<int>(row);
+  int newCol = static_cast<int>(col);
+
+  /* Look up only the nearby edges of a low-density image: */
+  if (sparseMap != nullptr) {
+    return sparseMap->hasNeighbor(newRow, newCol);
+  }
+
+  /* Iterate through the neighbors: */
+  for (int rowPlus = -1; rowPlus <= 1; ++rowPlus) {
+    for (int colPlus = -1; colPlus <= 1; ++colPlus) {
+
+      /* Update the new row and col: */
+      int changeCol = newCol + colPlus;
+      int changeRow = newRow + rowPlus;
+
+      /* Check to see if the range is valid: */
+      if (changeCol >= 0 && changeCol < searchImage->cols && changeRow >= 0 &&
+          changeRow < searchImage->rows) {
+
+        /* Check to see if there is an edge: */
+        if (searchImage->at<uchar>(changeRow, changeCol) == edgeValue)
+          return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/* DILATED BACKEND */
+
+/* Purpose: To get the name the backend is created with.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the name of the backend. */
+string DilatedBackend::name() const { return "dilated"; }
+
+/* Purpose: To get whether the backend answers from the spatial hash.
+ * Pre-conditions: None.
+ * Post-conditions: Returns false: score() reads its dense dilated map. */
+bool DilatedBackend::usesSparseMap() const { return false; }
+
+/* Purpose: To prepare the backend for a search image.
+ * Pre-conditions: searchImage is an edge-detected image.
+ * Post-conditions: dilated holds 1 at every padded (row + 1, col + 1) within
+ *          one pixel of an edge, and 0 elsewhere. */
+void DilatedBackend::prepare(const Mat &searchImage, int edgeValue,
+                             const SparseEdgeMap * /* sparseMap */) {
+  dilateEdges(searchImage, edgeValue, 0, dilated);
+}
+
+/* Purpose: To count the edge matches of a transformed exemplar.
+ * Pre-conditions: prepare() has been called. points are (col, row).
+ * Post-conditions: Returns the same count as the reference backend. */
+int DilatedBackend::score(const vector<Point> &points,
+                          pair<double, double> scale, int rotation,
+                          pair<int, int> origin) const {
+  int count = 0;
+
+  /* Use the same angle and transform as the reference, so the points land on
+   * the same pixels: */
+  const double pi = 3.14159265;
+  double cosVal = cos(rotation * (pi / 180));
+  double sinVal = sin(rotation * (pi / 180));
+
+  /* A point truncated to (row, col) is found at (row + 1, col + 1), which is
+   * in the padded map only if it is between 0 and rows + 1 (cols + 1): */
+  unsigned paddedRows = static_cast<unsigned>(dilated.rows);
+  unsigned paddedCols = static_cast<unsigned>(dilated.cols);
+
+  for (const Point &point : points) {
+    double newRow = ((sinVal * point.x) + (cosVal * point.y)) * scale.second +
+                    origin.first;
+    double newCol = ((cosVal * point.x) + (-sinVal * point.y)) * scale.first +
+                    origin.second;
+
+    unsigned row = static_cast<unsigned>(static_cast<int>(newRow) + 1);
+    unsigned col = static_cast<unsigned>(static_cast<int>(newCol) + 1);
+    if (row < paddedRows && col < paddedCols) {
+      count += dilated.ptr<uchar>(row)[col];
+    }
+  }
+  return count;
+}
@@ -0,0 +1,111 @@
+/* Description: The scoring stage of object recognition behind an interface,
+ * so faster scoring kernels can be swapped in at runtime and compared against
+ * the original one. A backend prepares whatever it needs from a search image
+ * once, then counts how many points of a transformed exemplar land within one
+ * pixel of an edge. The "reference" backend is the original scoring code. */
+#pragma once
+#include "sparseEdgeMap.h"
+#include <opencv2/core.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+class MatcherBackend {
+public:
+  /* Purpose: Destructor to let backends release their buffers.
+   * Pre-conditions: None.
+   * Post-conditions: Frees the backend. */
+  virtual ~MatcherBackend() {}
+
+  /* Purpose: To get the name the backend is created with.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the name of the backend. */
+  virtual string name() const = 0;
+  /* Purpose: To get whether the backend answers from the spatial hash.
+   * Pre-conditions: None.
+   * Post-conditions: Returns true if score() uses the sparseMap given to
+   *          prepare() instead of the dense image. */
+  virtual bool usesSparseMap() const = 0;
+  /* Purpose: To prepare the backend for a search image.
+   * Pre-conditions: searchImage is an edge-detected image that outlives the
+   *          calls to score(). sparseMap is its spatial hash, or nullptr.
+   * Post-conditions: The backend can score transformations on the image. A
+   *          backend whose usesSparseMap() is true answers from sparseMap
+   *          when there is one; every other backend ignores it and scores
+   *          on the dense image (or a dense map built from it), so the hash
+   *          then only prunes the grid translations in match(). */
+  virtual void prepare(const Mat &searchImage, int edgeValue,
+                       const SparseEdgeMap *sparseMap) = 0;
+  /* Purpose: To count the edge matches of a transformed exemplar.
+   * Pre-conditions: prepare() has been called. points are (col, row).
+   * Post-conditions: Returns how many points, rotated by rotation degrees,
+   *          scaled and placed at origin (row, col), are within one pixel of
+   *          an edge. */
+  virtual int score(const vector<Point> &points, pair<double, double> scale,
+                    int rotation, pair<int, int> origin) const = 0;
+};
+
+/* Purpose: To create a backend by name.
+ * Pre-conditions: None.
+ * Post-conditions: Returns a new backend the caller owns, or nullptr if there
+ *          is no backend with that name. */
+MatcherBackend *createMatcherBackend(const string &name);
+/* Purpose: To list the backends createMatcherBackend() knows.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the name of every backend. */
+vector<string> matcherBackendNames();
+/* Purpose: To dilate the edges of a search image into a padded map.
+ * Pre-conditions: searchImage is an edge-detected image and extraRows is at
+ *          least 0.
+ * Post-conditions: dilated is (rows + 2 + extraRows) x (cols + 2) and holds 1
+ *          at every padded (row + 1, col + 1) within one pixel of an edge, and
+ *          0 elsewhere. */
+void dilateEdges(const Mat &searchImage, int edgeValue, int extraRows,
+                 Mat &dilated);
+
+/* The original scoring code: double-precision transforms and a bounds-checked
+ * 3x3 neighbourhood, answered by the spatial hash when there is one. */
+class ReferenceBackend : public MatcherBackend {
+public:
+  /* Purpose: Constructor to create an unprepared backend.
+   * Pre-conditions: None.
+   * Post-conditions: Creates a backend with no search image. */
+  ReferenceBackend();
+
+  string name() const override;
+  bool usesSparseMap() const override;
+  void prepare(const Mat &searchImage, int edgeValue,
+               const SparseEdgeMap *sparseMap) override;
+  int score(const vector<Point> &points, pair<double, double> scale,
+            int rotation, pair<int, int> origin) const override;
+
+private:
+  /* Purpose: To check the neighbors of a given (row, col) to see if edge.
+   * Pre-conditions: None.
+   * Post-conditions: Returns true if an edge exists.  */
+  bool checkNeighbors(double row, double col) const;
+
+  const Mat *searchImage;
+  int edgeValue;
+  const SparseEdgeMap *sparseMap;
+};
+
+/* Dilates the edges once per search image into a padded map, so each point is
+ * one lookup with one range check instead of up to 9 checked lookups. */
+class DilatedBackend : public MatcherBackend {
+public:
+  string name() const override;
+  bool usesSparseMap() const override;
+  void prepare(const Mat &searchImage, int edgeValue,
+               const SparseEdgeMap *sparseMap) override;
+  int score(const vector<Point> &points, pair<double, double> scale,
+            int rotation, pair<int, int> origin) const override;
+
+private:
+  /* The search image dilated by one pixel, with a one pixel border so every
+   * (row, col) from -1 to rows (cols) can be looked up: */
+  Mat dilated;
+};
@@ -7,30 +7,72 @@
  * exemplar image is tested against the search image. If it surpases a certain
  * threshold, a match exists. */
 #include "objectRecognition.h"
+#include "resultCache.h"
+#include "strategySelector.h"
 
 /* Purpose: Constructor to create object and initialize data members.
  * Pre-conditions: Parameter is a valid image (e.g., not .gif).
- * Post-conditions: Initializes data members. */
-ObjectRecognition::ObjectRecognition(const Mat &exemplar) {
-  /* Store exemplar into data member: */
+ * Post-conditions: Initializes data members. Throws invalid_argument if
+ *          the exemplar is empty or profile is outside the ranges
+ *          documented in SearchProfile. */
+ObjectRecognition::ObjectRecognition(const Mat &exemplar,
+                                     const SearchProfile &profile) {
+  /* Reject a profile that would index past the quadrants or never advance
+   * through the search: */
+  if (profile.bucketSize != 4) {
+    throw invalid_argument("SearchProfile: bucketSize must be 4");
+  }
+  if (profile.gridStride <= 0 || profile.sparseStride <= 0) {
+    throw invalid_argument("SearchProfile: strides must be above 0");
+  }
+  if (profile.incrementScale <= 0 || profile.incrementRotation <= 0) {
+    throw invalid_argument("SearchProfile: increments must be above 0");
+  }
+  if (profile.sparseMargin < 0) {
+    throw invalid_argument("SearchProfile: sparseMargin must be at least 0");
+  }
+  if (exemplar.empty()) {
+    throw invalid_argument("ObjectRecognition: the exemplar is empty");
+  }
+
+  /* Store exemplar and search parameters into data members: */
   this->exemplar = exemplar.clone();
+  this->profile = profile;
 
   /* Calculate the maximum size of the xScale: */
-  maxXScale = maxPixelValue / exemplar.rows;
+  maxXScale = profile.maxPixelValue / exemplar.rows;
   /* If xScale exceeds 2.0, set it to 2.00: */
-  if (maxXScale > maxScale) {
-    maxXScale = maxScale;
+  if (maxXScale > profile.maxScale) {
+    maxXScale = profile.maxScale;
   }
 
   /* Calculate the maximum size of the yScale: */
-  maxYScale = maxPixelValue / exemplar.cols;
+  maxYScale = profile.maxPixelValue / exemplar.cols;
   /* If yScale exceeds 2.0, set it to 2.00: */
-  if (maxYScale > maxScale) {
-    maxYScale = maxScale;
+  if (maxYScale > profile.maxScale) {
+    maxYScale = profile.maxScale;
+  }
+
+  /* Reject a profile that leaves an axis of the transformation space empty,
+   * since every search indexes its first cell: */
+  if (dimensionSize(maxXScale, profile.incrementScale) == 0 ||
+      dimensionSize(maxYScale, profile.incrementScale) == 0) {
+    throw invalid_argument("SearchProfile: no scale fits the exemplar within "
+                           "maxPixelValue and maxScale");
+  }
+  if (dimensionSize(profile.maxRotation, profile.incrementRotation) == 0) {
+    throw invalid_argument("SearchProfile: maxRotation must be at least half "
+                           "of incrementRotation");
   }
 
   /* Count number of edges in exemplar image: */
   exemplarEdges = computeEdgeTotals(exemplar);
+
+  /* Collect the exemplar edge points used when scoring transformations: */
+  computeExemplarPoints();
+
+  /* Score with the original code until another backend is picked: */
+  backend = new ReferenceBackend();
 }
 
 /* Purpose: Destructor to remove dynamic memory.
@@ -46,33 +88,109 @@ ObjectRecognition::~ObjectRecognition() {
         delete transformCombinations[row][col][depth];
     }
   }
+
+  delete backend;
 }
 
 /* FUNCTIONS USED FOR OBJECT RECONGITION / DIVIDE AND CONQUER */
 
 /* Purpose: To perform object recognition on an exemplar and searchImage.
  * Pre-conditions: searchImage is a valid image (e.g., not .gif) that has
- * already been cropped.
+ * already been cropped. stats, if given, are the statistics trimImage
+ * returned for it.
  * Post-conditions: Returns true if the exemplar is found in the image. */
-bool ObjectRecognition::match(Mat &searchImage, const Mat &original, string name) {
-  /* Calculate the edges in the searchImage and the size of the searchImage to
-   * get ratio: */
-  searchEdges = computeEdgeTotals(searchImage);
+bool ObjectRecognition::match(Mat &searchImage, const Mat &original,
+                              const string &name, const EdgeStats *stats) {
+  /* Start the clock for the latency budget: */
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                         chrono::duration<double, milli>(latencyBudget));
+  timedOut = false;
+  probes = 0;
+  bestRatio = -1;
+  bestCombo = {0, 0, 0};
+  bestOrigin = make_pair(0, 0);
+  scratch.detections.clear();
+  detections.clear();
+  lastResult = MatchResult();
+
+  /* Calculate the edges in the searchImage, or reuse the count of the
+   * preprocessing pass, and the size of the searchImage to get ratio: */
+  searchEdges =
+      stats != nullptr ? stats->edges : computeEdgeTotals(searchImage);
   searchSize = static_cast<double>(searchImage.rows) *
                static_cast<double>(searchImage.cols);
   double searchImageRatio = searchEdges / searchSize;
 
-  double greatestRatio = 0;
+  /* Run the cheap rejection stages before the edge search: */
+  if (!passesCascade(searchImageRatio, original)) {
+    cout << "RESULTS FOR " << name << ": " << endl;
+    cout << "Rejected before edge matching. " << endl;
+    lastResult.elapsedMs = chrono::duration<double, milli>(
+                               chrono::steady_clock::now() - start)
+                               .count();
+    return false;
+  }
+
+  /* Reuse the result of a repeated or near-duplicate frame. The cascade
+   * runs first, so a cached verdict never overrides a rejection: */
+  EdgeFingerprint print;
+  if (resultCache != nullptr) {
+    print = resultCache->fingerprint(searchImage);
+    if (resultCache->lookup(print, lastResult, detections)) {
+      lastResult.cached = true;
+      lastResult.probes = 0;
+      lastResult.elapsedMs = chrono::duration<double, milli>(
+                                 chrono::steady_clock::now() - start)
+                                 .count();
+      return reportResult(original, name);
+    }
+  }
+
+  /* Search the faces found by the cascade, or the whole image: */
+  vector<Rect> &regions = scratch.regions;
+  regions.assign(searchRegions.begin(), searchRegions.end());
+  if (regions.empty()) {
+    regions.push_back(Rect(0, 0, searchImage.cols, searchImage.rows));
+  }
+
+  /* Spread the search image orientations once, so every probe is a table
+   * lookup: */
+  if (orientationMatching) {
+    computeResponseMaps(searchImage, original);
+  }
 
-  /* If the image ratio of edges compared to pixels is high, use divide and
-   * conquer on translation: */
-  if (searchImageRatio > 0.05) {
-    /* Calculate dimensions of the search image: */
-    pair<int, int> dimensions = make_pair(searchImage.rows, searchImage.cols);
+  double greatestRatio = 0;
 
-    /* Divide and conquer the translation of an image: */
-    greatestRatio =
-        divideAndConquer(searchImage, make_pair(0, 0), dimensions, -1, -1, 1);
+  /* Pick the translation strategy: a forced one, the cheapest by the
+   * selector's cost model, or the density rule: */
+  TranslationStrategy strategy = translationStrategy;
+  if (strategy == densityRule && strategySelector != nullptr) {
+    strategy = strategySelector->choose(searchSize, searchEdges,
+                                        lastResult.predictedMs,
+                                        lastResult.predictedProbes);
+  }
+  if (strategy == densityRule) {
+    /* If the image ratio of edges compared to pixels is high, use divide and
+     * conquer on translation: */
+    strategy = searchImageRatio > profile.translationDensity
+                   ? translationSearch
+                   : gridSearch;
+  }
+  lastResult.strategy = strategy;
+
+  if (strategy == translationSearch) {
+    backend->prepare(searchImage, edge, nullptr);
+    for (const Rect &region : regions) {
+      /* Calculate dimensions of the region: */
+      pair<int, int> dimensions = make_pair(region.height, region.width);
+
+      /* Divide and conquer the translation of the region: */
+      double currentRatio =
+          divideAndConquer(searchImage, make_pair(region.y, region.x),
+                           dimensions, -1, -1, 1);
+      greatestRatio = max(currentRatio, greatestRatio);
+    }
 
   } else {
     /* Calculate dimensions for the transformation space: */
@@ -80,39 +198,121 @@ bool ObjectRecognition::match(Mat &searchImage, const Mat &original, string name
                                            transformCombinations[0].size());
     double currentRatio = 0;
 
+    /* Most of a low-density image is empty, so keep only its edges in a
+     * spatial hash and answer the neighbour queries from it: */
+    sparseSearch.build(searchImage, edge, hashCellSize);
+    backend->prepare(searchImage, edge, &sparseSearch);
+    if (!backend->usesSparseMap() && !orientationMatching &&
+        !warnedDenseBackend) {
+      cout << "Note: the " << backend->name() << " backend scores with its "
+           << "dense map; the spatial hash only prunes translations."
+           << endl;
+      warnedDenseBackend = true;
+    }
+
+    /* A translation further from every edge than the largest transformed
+     * exemplar reaches cannot match any edge, so it is skipped: */
+    sparseSearch.markCandidates(profile.gridStride,
+                                static_cast<int>(transformReach) + 2);
+
     /* Iterate through the image to receive translation values for divide and
      * conquer on scale: */
-    for (int r = 0; r < searchImage.rows; r += 25) {
-      for (int c = 0; c < searchImage.cols; c += 25) {
-        currentRatio =
-            divideAndConquerScale(searchImage, make_pair(r, c), make_pair(0, 0),
-                                  dimensions, -1, -1, 1);
-        if (currentRatio > greatestRatio) {
-          greatestRatio = currentRatio;
+    vector<pair<int, int>> &origins = scratch.origins;
+    origins.clear();
+    for (const Rect &region : regions) {
+      for (int r = region.y; r < region.y + region.height;
+           r += profile.gridStride) {
+        for (int c = region.x; c < region.x + region.width;
+             c += profile.gridStride) {
+          if (!candidatePruning || sparseSearch.isCandidate(r, c)) {
+            origins.push_back(make_pair(r, c));
+          }
         }
       }
     }
+
+    /* With a latency budget, try the translations covering the most edges
+     * first so the best result is likely found before time runs out: */
+    if (latencyBudget > 0) {
+      orderTranslations(searchImage, origins);
+    }
+
+    for (const pair<int, int> &origin : origins) {
+      if (deadlinePassed()) {
+        break;
+      }
+      currentRatio = divideAndConquerScale(searchImage, origin, make_pair(0, 0),
+                                           dimensions, -1, -1, 1);
+      if (currentRatio > greatestRatio) {
+        greatestRatio = currentRatio;
+      }
+    }
+  }
+
+  /* Store the outcome of the search: */
+  lastResult.found = greatestRatio > profile.matchThreshold;
+  lastResult.ratio = greatestRatio;
+  lastResult.completed = !timedOut;
+  lastResult.probes = probes;
+  if (bestRatio >= 0) {
+    lastResult.transformation = bestCombo;
+    lastResult.origin = bestOrigin;
+    lastResult.box = matchBox(bestCombo, bestOrigin, original.size());
+  } else {
+    /* Nothing was scored, so there is no box to report: */
+    lastResult.box = Rect();
+  }
+  if (multiDetection) {
+    suppressDetections(original.size());
+  }
+  lastResult.elapsedMs =
+      chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+          .count();
+  if (lastResult.predictedMs >= 0) {
+    strategySelector->recordError(lastResult.predictedMs,
+                                  lastResult.elapsedMs);
+    cout << "Strategy: "
+         << (strategy == translationSearch ? "translation" : "grid")
+         << " (predicted " << lastResult.predictedMs << " ms, took "
+         << lastResult.elapsedMs << " ms)" << endl;
+  }
+  if (timedOut) {
+    cout << "Search stopped at the latency budget of " << latencyBudget
+         << " ms. " << endl;
+  }
+
+  /* Only a completed search is worth reusing: */
+  if (resultCache != nullptr && lastResult.completed) {
+    resultCache->insert(print, lastResult, detections);
+  }
+
+  return reportResult(original, name);
+}
+
+/* Purpose: To hand the last result to the writer and print it.
+ * Pre-conditions: lastResult holds the outcome of the search.
+ * Post-conditions: Returns true if the exemplar was found in the image. */
+bool ObjectRecognition::reportResult(const Mat &original, const string &name) {
+  double greatestRatio = lastResult.ratio;
+
+  /* Hand the result to the background writer, which illustrates it and saves
+   * it without holding up the verdict: */
+  if (resultWriter != nullptr) {
+    resultWriter->submit(original, lastResult.box, lastResult.found, name);
   }
 
   /* Check to see if there was a match. If there is, return true. Otherwise,
    * return false: */
-  if (greatestRatio > 0.70) {
-    cout << "RESULTS FOR " + name + ": " << endl;
+  if (lastResult.found) {
+    cout << "RESULTS FOR " << name << ": " << endl;
     cout << "Person is wearing a mask. " << endl;
     cout << "Match Percentage: " << greatestRatio * 100 << "%" << endl;
-
-    /* Illustrate the match and save to the default directory: */
-    drawMatch(original, greatestRatio, name);
-
     return true;
   }
 
-  cout << "RESULTS FOR " + name + ": " << endl;
+  cout << "RESULTS FOR " << name << ": " << endl;
   cout << "Person is not wearing a mask. " << endl;
   cout << "Match Percentage: " << greatestRatio * 100 << "%" << endl;
-
-  /* Illustrate the non-match and save to the default directory: */
-  drawMatch(original, greatestRatio, name);
   return false;
 }
 
@@ -131,6 +331,11 @@ double ObjectRecognition::divideAndConquer(const Mat &searchImage,
 
   previousCount = currentCount;
 
+  /* Stop dividing once the latency budget has run out: */
+  if (deadlinePassed()) {
+    return previousCount;
+  }
+
   /* Divide the dimensions by 2 to get 4 rectangles for divide and conquer:
    */
   pair<int, int> newDimensions =
@@ -143,11 +348,12 @@ double ObjectRecognition::divideAndConquer(const Mat &searchImage,
   }
 
   /* Store the edge count from each respected quadrant: */
-  map<pair<int, int>, double> edgeCounts;
+  Candidate edgeCounts[4];
+  int edgeCountSize = 0;
 
   /* x and y increment: */
-  int xIncrement = dimensions.first / bucketSize;
-  int yIncrement = dimensions.second / bucketSize;
+  int xIncrement = dimensions.first / profile.bucketSize;
+  int yIncrement = dimensions.second / profile.bucketSize;
   pair<double, double> scale = make_pair(0, 0);
 
   /* Create dimensions for transformation space: */
@@ -159,7 +365,7 @@ double ObjectRecognition::divideAndConquer(const Mat &searchImage,
    * the transformation space: */
   for (int x = 1; x < 3; ++x) {
     /* Re-initialize the y-increment for its next iteration: */
-    yIncrement = dimensions.second / bucketSize;
+    yIncrement = dimensions.second / profile.bucketSize;
     /* Calculate the x value that is in the middle of a quadrant: */
     int row = xIncrement + startingPoint.first;
 
@@ -173,7 +379,9 @@ double ObjectRecognition::divideAndConquer(const Mat &searchImage,
 
       /* Check to see if the count is within bounds: */
       if (checkBounds(result, levelOfDivide)) {
-        edgeCounts[make_pair(row, col)] = result;
+        edgeCounts[edgeCountSize].ratio = result;
+        edgeCounts[edgeCountSize].cell = make_pair(row, col);
+        edgeCountSize++;
       }
 
       /* Increment y to the next quadrant in the middle: */
@@ -184,19 +392,26 @@ double ObjectRecognition::divideAndConquer(const Mat &searchImage,
     xIncrement += (x + 1) * xIncrement;
   }
 
+  /* Visit the quadrants with the greatest count first, so the most promising
+   * work is done before a latency budget runs out: */
+  orderCandidates(edgeCounts, edgeCountSize);
+
   double maxCount = previousCount;
   /* If the count is greater than the bounds, go into the given cell and
    * divide and conquer: */
-  for (auto it = edgeCounts.begin(); it != edgeCounts.end(); ++it) {
+  for (Candidate *it = edgeCounts; it != edgeCounts + edgeCountSize; ++it) {
+    if (deadlinePassed()) {
+      break;
+    }
 
     /* Have new origin be upper right hand of the matched quadrant: */
-    int newRow = it->first.first - (dimensions.first / bucketSize);
-    int newCol = it->first.second - (dimensions.second / bucketSize);
+    int newRow = it->cell.first - (dimensions.first / profile.bucketSize);
+    int newCol = it->cell.second - (dimensions.second / profile.bucketSize);
     pair<int, int> newPoint = make_pair(newRow, newCol);
 
     /* Dive and conquer on that new origin: */
     currentCount =
-        divideAndConquer(searchImage, newPoint, newDimensions, it->second,
+        divideAndConquer(searchImage, newPoint, newDimensions, it->ratio,
                          previousCount, levelOfDivide + 1);
 
     maxCount = max(currentCount, maxCount);
@@ -220,6 +435,11 @@ double ObjectRecognition::divideAndConquerScale(
 
   previousCount = currentCount;
 
+  /* Stop dividing once the latency budget has run out: */
+  if (deadlinePassed()) {
+    return previousCount;
+  }
+
   /* Divide the dimensions to get 4 rectangles for divide and conquer: */
   pair<int, int> newDimensions =
       make_pair(dimensions.first / 2, dimensions.second / 2);
@@ -236,17 +456,18 @@ double ObjectRecognition::divideAndConquerScale(
   pair<double, double> origin = make_pair(tRow, tCol);
 
   /* Store the edge count from each respected quadrant: */
-  map<pair<int, int>, double> edgeCounts;
+  Candidate edgeCounts[4];
+  int edgeCountSize = 0;
 
   /* x and y increment: */
-  int xIncrement = dimensions.first / bucketSize;
-  int yIncrement = dimensions.second / bucketSize;
+  int xIncrement = dimensions.first / profile.bucketSize;
+  int yIncrement = dimensions.second / profile.bucketSize;
   pair<double, double> scale = make_pair(0, 0);
 
   /* Divide and conquer: */
   for (int x = 1; x < 3; ++x) {
     /* Re-initialize the y-increment for its next iteration: */
-    yIncrement = dimensions.second / bucketSize;
+    yIncrement = dimensions.second / profile.bucketSize;
     /* Calculate the x value that is in the middle of a quadrant: */
     int row = xIncrement + startingPoint.first;
 
@@ -255,28 +476,35 @@ double ObjectRecognition::divideAndConquerScale(
       int col = yIncrement + startingPoint.second;
 
       /* Keep track of the highest count at a given scale transformation: */
+      const vector<Transformations *> &rotations =
+          transformCombinations[row][col];
+      scale.first = rotations[0]->xScale;
+      scale.second = rotations[0]->yScale;
+      int rotation = 0;
       double highestRatio = 0;
-      scale.first = transformCombinations[row][col][0]->xScale;
-      scale.second = transformCombinations[row][col][0]->yScale;
 
-      /* Iterate through multiple rotations, finding the best match: */
-      int rotation = 0;
-      for (int depth = 0; depth < transformCombinations[row][col].size();
-           ++depth) {
-        pair<double, double> result =
-            getCount(searchImage, scale,
-                     transformCombinations[row][col][depth]->rotation, origin);
-        double ratio = result.second / result.first;
-
-        if (ratio > highestRatio) {
-          highestRatio = ratio;
-          rotation = transformCombinations[row][col][depth]->rotation;
-        }
+      /* Coarse levels only decide whether to recurse, so probe them with the
+       * sparse exemplar points first. A quadrant that comes within the
+       * safety margin of the bound is scored again at every rotation with
+       * every point, so its stored ratio and rotation are the same as a
+       * full-resolution probe: */
+      bool fullProbe = true;
+      if (levelOfDivide <= profile.sparseLevels) {
+        highestRatio = bestRotation(searchImage, sparseExemplarPoints,
+                                    rotations, translation, rotation);
+        fullProbe =
+            checkBounds(highestRatio + profile.sparseMargin, levelOfDivide);
+      }
+      if (fullProbe) {
+        highestRatio = bestRotation(searchImage, exemplarPoints, rotations,
+                                    translation, rotation);
       }
 
       /* Check to see if the count is within bounds: */
-      if (checkBounds(highestRatio, levelOfDivide)) {
-        edgeCounts[make_pair(row, col)] = highestRatio;
+      if (fullProbe && checkBounds(highestRatio, levelOfDivide)) {
+        edgeCounts[edgeCountSize].ratio = highestRatio;
+        edgeCounts[edgeCountSize].cell = make_pair(row, col);
+        edgeCountSize++;
 
         /* Create transformation object: */
         Transformations currentCombo;
@@ -284,7 +512,7 @@ double ObjectRecognition::divideAndConquerScale(
         currentCombo.yScale = scale.second;
         currentCombo.rotation = rotation;
 
-        bestTransformation[highestRatio] = make_pair(currentCombo, origin);
+        recordBest(highestRatio, currentCombo, make_pair(tRow, tCol));
       }
 
       /* Increment y to the next quadrant in the middle: */
@@ -295,25 +523,325 @@ double ObjectRecognition::divideAndConquerScale(
     xIncrement += (x + 1) * xIncrement;
   }
 
+  /* Visit the quadrants with the greatest count first, so the most promising
+   * work is done before a latency budget runs out: */
+  orderCandidates(edgeCounts, edgeCountSize);
+
   double maxCount = previousCount;
   /* If the count is greater than the bounds, go into the given cell and
    * divide and conquer: */
-  for (auto it = edgeCounts.begin(); it != edgeCounts.end(); ++it) {
+  for (Candidate *it = edgeCounts; it != edgeCounts + edgeCountSize; ++it) {
+    if (deadlinePassed()) {
+      break;
+    }
 
     /* Have new origin be upper right hand of the matched quadrant: */
-    int newRow = it->first.first - (dimensions.first / bucketSize);
-    int newCol = it->first.second - (dimensions.second / bucketSize);
+    int newRow = it->cell.first - (dimensions.first / profile.bucketSize);
+    int newCol = it->cell.second - (dimensions.second / profile.bucketSize);
     pair<int, int> newPoint = make_pair(newRow, newCol);
 
     /* Dive and conquer on that new origin: */
     currentCount =
         divideAndConquerScale(searchImage, origin, newPoint, newDimensions,
-                              it->second, previousCount, levelOfDivide + 1);
+                              it->ratio, previousCount, levelOfDivide + 1);
     maxCount = max(currentCount, maxCount);
   }
   return maxCount;
 }
 
+/* Purpose: To order grid translations so the most promising come first.
+ * Pre-conditions: searchImage is the edge-detected search image.
+ * Post-conditions: Sorts origins by the number of edges an unscaled exemplar
+ *          placed there would cover, greatest first. */
+void ObjectRecognition::orderTranslations(
+    const Mat &searchImage, vector<pair<int, int>> &origins) const {
+  /* Sum the edges with an integral image so each window costs 4 lookups.
+   * Each edge adds edge to the sums: */
+  compare(searchImage, edge, scratch.edgeMask, CMP_EQ);
+  integral(scratch.edgeMask, scratch.edgeSums, CV_32S);
+  const Mat &sums = scratch.edgeSums;
+
+  vector<pair<int, pair<int, int>>> &order = scratch.order;
+  order.clear();
+  for (const pair<int, int> &origin : origins) {
+    int top = origin.first;
+    int left = origin.second;
+    int bottom = min(top + exemplar.rows, searchImage.rows);
+    int right = min(left + exemplar.cols, searchImage.cols);
+    int total = (sums.at<int>(bottom, right) - sums.at<int>(top, right) -
+                 sums.at<int>(bottom, left) + sums.at<int>(top, left)) /
+                edge;
+    order.push_back(make_pair(total, origin));
+  }
+  sort(order.begin(), order.end(),
+       [](const pair<int, pair<int, int>> &a,
+          const pair<int, pair<int, int>> &b) {
+         /* Break ties by position so the order is the same every time: */
+         if (a.first != b.first) {
+           return a.first > b.first;
+         }
+         return a.second < b.second;
+       });
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    origins[i] = order[i].second;
+  }
+}
+
+/* Purpose: To find the best rotation of one scale at a translation.
+ * Pre-conditions: points is exemplarPoints or sparseExemplarPoints and
+ *          rotations is one (xScale, yScale) cell of transformCombinations.
+ * Post-conditions: Returns the greatest ratio over the rotations and sets
+ *          rotation to the one that gave it. */
+double ObjectRecognition::bestRotation(
+    const Mat &searchImage, const vector<Point> &points,
+    const vector<Transformations *> &rotations, pair<int, int> origin,
+    int &rotation) const {
+  pair<double, double> scale =
+      make_pair(rotations[0]->xScale, rotations[0]->yScale);
+  double highestRatio = 0;
+  rotation = 0;
+
+  /* Iterate through multiple rotations, finding the best match: */
+  for (const Transformations *combo : rotations) {
+    pair<double, double> result =
+        getCount(searchImage, points, scale, combo->rotation, origin);
+    double ratio = result.second / result.first;
+
+    if (ratio > highestRatio) {
+      highestRatio = ratio;
+      rotation = combo->rotation;
+    }
+  }
+  return highestRatio;
+}
+
+/* Purpose: To order candidates from the greatest ratio down.
+ * Pre-conditions: count is at most the size of candidates.
+ * Post-conditions: Sorts the first count candidates in place. */
+void ObjectRecognition::orderCandidates(Candidate candidates[],
+                                        int count) const {
+  /* There are at most 4 candidates, so an insertion sort is enough: */
+  for (int i = 1; i < count; ++i) {
+    Candidate current = candidates[i];
+    int j = i - 1;
+    while (j >= 0 && candidates[j].ratio < current.ratio) {
+      candidates[j + 1] = candidates[j];
+      j--;
+    }
+    candidates[j + 1] = current;
+  }
+}
+
+/* Purpose: To keep track of the best transformation.
+ * Pre-conditions: None.
+ * Post-conditions: Stores the transformation if its ratio is at least the
+ *          best ratio so far. */
+void ObjectRecognition::recordBest(double ratio, const Transformations &combo,
+                                   pair<int, int> origin) const {
+  if (ratio >= bestRatio) {
+    bestRatio = ratio;
+    bestCombo = combo;
+    bestOrigin = origin;
+  }
+
+  /* Keep every candidate that would be a match on its own: */
+  if (multiDetection && ratio > profile.matchThreshold) {
+    Detection detection;
+    detection.score = ratio;
+    detection.transformation = combo;
+    detection.origin = origin;
+    scratch.detections.push_back(detection);
+  }
+}
+
+/* Purpose: To remove detections that overlap a better detection.
+ * Pre-conditions: scratch.detections holds the candidates of the search.
+ * Post-conditions: Fills detections from the greatest score down. */
+void ObjectRecognition::suppressDetections(Size imageSize) {
+  vector<Detection> &candidates = scratch.detections;
+  for (Detection &candidate : candidates) {
+    candidate.box =
+        matchBox(candidate.transformation, candidate.origin, imageSize);
+  }
+  sort(candidates.begin(), candidates.end(),
+       [](const Detection &a, const Detection &b) {
+         /* Break ties by position so the order is the same every time: */
+         if (a.score != b.score) {
+           return a.score > b.score;
+         }
+         return a.origin < b.origin;
+       });
+
+  /* Greedily keep each candidate unless a kept one overlaps it too much: */
+  for (const Detection &candidate : candidates) {
+    bool suppressed = false;
+    for (const Detection &kept : detections) {
+      double overlap = (candidate.box & kept.box).area();
+      double total = candidate.box.area() + kept.box.area() - overlap;
+      if (total > 0 && overlap / total > maxDetectionOverlap) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) {
+      detections.push_back(candidate);
+    }
+  }
+}
+
+/* FUNCTION USED FOR THE LATENCY BUDGET */
+
+/* Purpose: To check if the latency budget has run out.
+ * Pre-conditions: match() has set the deadline.
+ * Post-conditions: Returns true, and marks the search as incomplete, if there
+ *          is a budget and it has run out. */
+bool ObjectRecognition::deadlinePassed() const {
+  if (timedOut) {
+    return true;
+  }
+  if (latencyBudget > 0 && chrono::steady_clock::now() >= deadline) {
+    timedOut = true;
+  }
+  return timedOut;
+}
+
+/* Purpose: To get the outcome of the last call to match().
+ * Pre-conditions: None.
+ * Post-conditions: Returns the verdict, best ratio, its transformation and
+ *          whether the search completed. */
+const MatchResult &ObjectRecognition::getLastResult() const {
+  return lastResult;
+}
+
+/* Purpose: To set the cache of results for repeated frames.
+ * Pre-conditions: cache outlives this object and is only used by it, or is
+ *          nullptr. Multi-detection is not switched while cache holds results.
+ * Post-conditions: match() returns the cached verdict, box and detections of a
+ *          repeated or near-duplicate frame that passes the rejection cascade
+ *          without searching, and caches the result of every completed
+ *          search. */
+void ObjectRecognition::setResultCache(ResultCache *cache) {
+  resultCache = cache;
+}
+
+/* Purpose: To get the cache of results for repeated frames.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the result cache, or nullptr. */
+ResultCache *ObjectRecognition::getResultCache() const { return resultCache; }
+
+/* Purpose: To force how the translations are searched.
+ * Pre-conditions: None.
+ * Post-conditions: match() uses strategy. densityRule (the default) lets the
+ *          strategy selector, if any, or the density rule decide. */
+void ObjectRecognition::setTranslationStrategy(TranslationStrategy strategy) {
+  translationStrategy = strategy;
+}
+
+/* Purpose: To get how the translations are searched.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the forced strategy, or densityRule. */
+TranslationStrategy ObjectRecognition::getTranslationStrategy() const {
+  return translationStrategy;
+}
+
+/* Purpose: To turn skipping translations far from every edge on or off.
+ * Pre-conditions: None.
+ * Post-conditions: When enabled (the default), the grid search skips the
+ *          translations no transformed exemplar can reach an edge from.
+ *          Disabled, it probes every translation on the grid. */
+void ObjectRecognition::setCandidatePruning(bool enabled) {
+  candidatePruning = enabled;
+}
+
+/* Purpose: To pick the translation strategy from measured cost.
+ * Pre-conditions: selector outlives this object, or is nullptr.
+ * Post-conditions: Unless a strategy is forced, match() searches with the
+ *          strategy selector predicts is cheapest and reports the prediction
+ *          error to it. */
+void ObjectRecognition::setStrategySelector(StrategySelector *selector) {
+  strategySelector = selector;
+}
+
+/* Purpose: To pick the backend that scores transformations.
+ * Pre-conditions: None.
+ * Post-conditions: Scores edge matches with the backend called name and
+ *          returns true, or keeps the current backend and returns false if
+ *          there is no such backend. Orientation matching always scores with
+ *          the response maps. The first grid search with a backend that does
+ *          not answer from the spatial hash prints a note saying so. */
+bool ObjectRecognition::setMatcherBackend(const string &name) {
+  MatcherBackend *picked = createMatcherBackend(name);
+  if (picked == nullptr) {
+    return false;
+  }
+  delete backend;
+  backend = picked;
+  warnedDenseBackend = false;
+  return true;
+}
+
+/* Purpose: To get the backend that scores transformations.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the name of the backend. */
+string ObjectRecognition::getMatcherBackend() const { return backend->name(); }
+
+/* Purpose: To get every detection of the last call to match().
+ * Pre-conditions: Multi-detection is on.
+ * Post-conditions: Returns the detections left after non-maximum
+ *          suppression, from the greatest score down. */
+const vector<Detection> &ObjectRecognition::getDetections() const {
+  return detections;
+}
+
+/* Purpose: To collect every candidate above the match threshold instead of
+ *          only the greatest.
+ * Pre-conditions: maxOverlap is between 0 and 1.
+ * Post-conditions: match() keeps the candidates found during its single
+ *          traversal and suppresses boxes that overlap a better one by more
+ *          than maxOverlap (intersection over union). */
+void ObjectRecognition::setMultiDetection(bool enabled, double maxOverlap) {
+  multiDetection = enabled;
+  maxDetectionOverlap = maxOverlap;
+}
+
+/* Purpose: To get the parameters of the search.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the search profile given to the constructor. */
+const SearchProfile &ObjectRecognition::getSearchProfile() const {
+  return profile;
+}
+
+/* Purpose: To set where outlined results are sent.
+ * Pre-conditions: writer outlives this object, or is nullptr.
+ * Post-conditions: match() submits every result to writer once the verdict is
+ *          known. nullptr turns saving results off. The writer copies the
+ *          images it keeps, so the original given to match() can be reused
+ *          as soon as match() returns. */
+void ObjectRecognition::setResultWriter(ResultWriter *writer) {
+  resultWriter = writer;
+}
+
+/* Purpose: To get where outlined results are sent.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the result writer, or nullptr. */
+ResultWriter *ObjectRecognition::getResultWriter() const {
+  return resultWriter;
+}
+
+/* Purpose: To bound the time a call to match() may spend searching.
+ * Pre-conditions: milliseconds is 0 (no limit) or positive.
+ * Post-conditions: match() explores the most promising work first and returns
+ *          the best result found once the budget runs out. */
+void ObjectRecognition::setLatencyBudget(double milliseconds) {
+  latencyBudget = milliseconds;
+}
+
+/* Purpose: To get the time a call to match() may spend searching.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the budget in milliseconds, or 0 (no limit). */
+double ObjectRecognition::getLatencyBudget() const { return latencyBudget; }
+
 /* FUNCTION USED FOR BOUND CHECKING */
 
 /* Purpose: To check the bound of a given transformed image.
@@ -325,8 +853,8 @@ bool ObjectRecognition::checkBounds(double ratio, int levelOfDivide) const {
 
   /* If the search image has a lot of edges compared to its size, it must pass a
    * bigger decimal to go further into divide and conquer: */
-  if (searchImageRatio > 0.06) {
-    if (ratio > 0.20 * (levelOfDivide))
+  if (searchImageRatio > profile.boundsDensity) {
+    if (ratio > profile.denseBoundFactor * (levelOfDivide))
       return true;
 
     return false;
@@ -334,7 +862,7 @@ bool ObjectRecognition::checkBounds(double ratio, int levelOfDivide) const {
 
   /* If the search image does not have a lot of edges compared to its size, the
    * bound to be passed is smaller: */
-  if (ratio > 0.15 * (levelOfDivide))
+  if (ratio > profile.sparseBoundFactor * (levelOfDivide))
     return true;
 
   return false;
@@ -343,86 +871,79 @@ bool ObjectRecognition::checkBounds(double ratio, int levelOfDivide) const {
 /* FUNCTIONS USED FOR FINDING MATCH EDGES */
 
 /* Purpose: To calculate the count given the transformation.
- * Pre-conditions: None.
+ * Pre-conditions: points is exemplarPoints or sparseExemplarPoints.
  * Post-conditions: returns the total edges of an transformed exemplar and
  * the total edge matches at a given point on the image  */
 pair<double, double> ObjectRecognition::getCount(const Mat &searchImage,
+                                                 const vector<Point> &points,
                                                  pair<double, double> scale,
                                                  int rotation,
                                                  pair<int, int> origin) const {
-  int count = 0;
-  int totalEdges = 0;
-
-  /* Iterate through the exemplar: */
-  for (int rowEx = 0; rowEx < exemplar.rows; ++rowEx) {
-    for (int colEx = 0; colEx < exemplar.cols; ++colEx) {
-      /* Transform exemplar point to match to search image: */
-      if (exemplar.at<uchar>(rowEx, colEx) != edge) {
-        continue;
-      }
-      totalEdges++;
-
-      double newRow = rowEx;
-      double newCol = colEx;
-
-      /* Perform the rotation transformation and convert degrees to radians.
-       * Then find cos and sin values: */
-      const double pi = 3.14159265;
-      double cosVal = cos(rotation * (pi / 180));
-      double sinVal = sin(rotation * (pi / 180));
-
-      double radianRow = (sinVal * colEx) + (cosVal * rowEx);
-      double radianCol = (cosVal * colEx) + (-sinVal * rowEx);
-
-      newRow = radianRow;
-      newCol = radianCol;
-
-      /* Perform the scale transformation: */
-      newRow = static_cast<double>(newRow * scale.second);
-      newCol = static_cast<double>(newCol * scale.first);
-
-      /* Set the exemplar point with respect to origin: */
-      newRow += static_cast<double>(origin.first);
-      newCol += static_cast<double>(origin.second);
+  double count = 0;
+  int totalEdges = static_cast<int>(points.size());
+  probes++;
+
+  /* Count the edge matches with the backend: */
+  if (!orientationMatching) {
+    count = backend->score(points, scale, rotation, origin);
+    return make_pair(totalEdges, count);
+  }
 
-      /* Check if edge: */
-      if (checkNeighbors(searchImage, newRow, newCol)) {
-        count++;
-      }
-    }
+  /* Convert degrees to radians and find the cos and sin values once for the
+   * whole transformation: */
+  const double pi = 3.14159265;
+  double cosVal = cos(rotation * (pi / 180));
+  double sinVal = sin(rotation * (pi / 180));
+
+  /* Rotating the exemplar rotates its gradient orientations by the same
+   * angle, rounded to the nearest whole bin. Point the table of every
+   * exemplar bin at the map of its rotated bin once for the probe: */
+  int binShift = static_cast<int>(
+      floor(rotation / (180.0 / orientationBins) + 0.5));
+  binShift = ((binShift % orientationBins) + orientationBins) % orientationBins;
+  const uchar *maps[orientationBins + 1];
+  for (int bin = 0; bin < orientationBins; ++bin) {
+    maps[bin] = responseMaps[(bin + binShift) % orientationBins].data;
+  }
+  maps[unorientedBin] = responseMaps[unorientedBin].data;
+  const vector<uchar> &bins =
+      &points == &sparseExemplarPoints ? sparsePointBins : exemplarPointBins;
+
+  /* Transform every exemplar point to its offset in the maps first, with no
+   * lookups in the loop, so the compiler can vectorize it: */
+  vector<int> &offsets = scratch.offsets;
+  offsets.resize(points.size());
+  const unsigned rows = static_cast<unsigned>(searchImage.rows);
+  const unsigned cols = static_cast<unsigned>(searchImage.cols);
+  const int stride = static_cast<int>(responseMaps[0].step);
+  for (size_t i = 0; i < points.size(); ++i) {
+    int rowEx = points[i].y;
+    int colEx = points[i].x;
+
+    /* Perform the rotation and scale transformations and set the point with
+     * respect to origin: */
+    double newRow = ((sinVal * colEx) + (cosVal * rowEx)) * scale.second +
+                    static_cast<double>(origin.first);
+    double newCol = ((cosVal * colEx) + (-sinVal * rowEx)) * scale.first +
+                    static_cast<double>(origin.second);
+
+    /* A negative row or col wraps to a large unsigned value: */
+    int row = static_cast<int>(newRow);
+    int col = static_cast<int>(newCol);
+    bool inside = static_cast<unsigned>(row) < rows &&
+                  static_cast<unsigned>(col) < cols;
+    offsets[i] = inside ? row * stride + col : -1;
   }
-  return make_pair(totalEdges, count);
-}
 
-/* Purpose: To check the neighbors of a given (row, col) to see if edge.
- * Pre-conditions: None.
- * Post-conditions: Returns true if an edge exists.  */
-bool ObjectRecognition::checkNeighbors(const Mat &searchImage, double row,
-                                       double col) const {
-  /* New row and cols: */
-  int newRow = static_cast<int>(row);
-  int newCol = static_cast<int>(col);
-
-  /* Iterate through the neighbors: */
-  for (int rowPlus = -1; rowPlus <= 1; ++rowPlus) {
-    for (int colPlus = -1; colPlus <= 1; ++colPlus) {
-
-      /* Update the new row and col: */
-      int changeCol = newCol + colPlus;
-      int changeRow = newRow + rowPlus;
-
-      /* Check to see if the range is valid: */
-      if (changeCol >= 0 && changeCol < searchImage.cols && changeRow >= 0 &&
-          changeRow < searchImage.rows) {
-
-        /* Check to see if there is an edge: */
-        if (searchImage.at<uchar>(changeRow, changeCol) == edge)
-          return true;
-      }
+  /* Score every point with the response map of its rotated orientation: */
+  int responses = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (offsets[i] >= 0) {
+      responses += maps[bins[i]][offsets[i]];
     }
   }
-
-  return false;
+  count = responses / static_cast<double>(sameBinResponse);
+  return make_pair(totalEdges, count);
 }
 
 /* FUNCTIONS USED FOR THE TRANSFORMATION SPACE */
@@ -432,13 +953,14 @@ bool ObjectRecognition::checkNeighbors(const Mat &searchImage, double row,
  * Post-conditions: Creates a transformation space for scaling/rotation. */
 void ObjectRecognition::transformationSpace() {
   /* Initialize dimension size for transformation space. */
-  int xScale = dimensionSize(maxXScale, incrementScale);
-  int yScale = dimensionSize(maxYScale, incrementScale);
-  int rotationScale = dimensionSize(maxRotation, incrementRotation);
+  int xScale = dimensionSize(maxXScale, profile.incrementScale);
+  int yScale = dimensionSize(maxYScale, profile.incrementScale);
+  int rotationScale =
+      dimensionSize(profile.maxRotation, profile.incrementRotation);
 
   /* Calculate the transformation combinations per (row, col, z): */
-  double xIncrement = 0.5;
-  double yIncrement = 0.5;
+  double xIncrement = profile.minScale;
+  double yIncrement = profile.minScale;
   int rotation = 0;
 
   /* Iterate through and calculate the xScale, yScale, and rotation
@@ -455,20 +977,27 @@ void ObjectRecognition::transformationSpace() {
         newTransformCombo->yScale = yIncrement;
         newTransformCombo->rotation = rotation;
 
+        /* Rotation keeps distances, so the scaled corner opposite the origin
+         * is the furthest any point of this combination reaches: */
+        double reachCols = xIncrement * exemplar.cols;
+        double reachRows = yIncrement * exemplar.rows;
+        transformReach = max(transformReach, sqrt(reachCols * reachCols +
+                                                  reachRows * reachRows));
+
         /* Increment rotation for next iteration: */
-        rotation += incrementRotation;
+        rotation += profile.incrementRotation;
         temp.push_back(newTransformCombo);
       }
 
       /* Increment yScale for next iteration: */
-      yIncrement += incrementScale;
+      yIncrement += profile.incrementScale;
       rotation = 0;
       transformSpace.push_back(temp);
     }
 
     /* Increment xScale for next iteration: */
-    xIncrement += incrementScale;
-    yIncrement = 0.5;
+    xIncrement += profile.incrementScale;
+    yIncrement = profile.minScale;
     transformCombinations.push_back(transformSpace);
   }
 }
@@ -494,6 +1023,217 @@ void ObjectRecognition::printTransformationSpace() const {
   }
 }
 
+/* FUNCTIONS USED FOR THE REJECTION CASCADE */
+
+/* Purpose: To set the cheap stages that run before the edge search.
+ * Pre-conditions: faceCascadePath, if set, names a readable cascade file.
+ * Post-conditions: Stores the stages and loads the face cascade. Returns false
+ *          if the face cascade could not be loaded. */
+bool ObjectRecognition::setRejectionCascade(const RejectionCascade &cascade) {
+  rejection = cascade;
+  faceCascade = CascadeClassifier();
+
+  if (!rejection.faceCascadePath.empty() &&
+      !faceCascade.load(rejection.faceCascadePath)) {
+    cout << "Could not load face cascade " + rejection.faceCascadePath << endl;
+    rejection.faceCascadePath.clear();
+    return false;
+  }
+  return true;
+}
+
+/* Purpose: To run the rejection cascade on a search image.
+ * Pre-conditions: searchEdges and searchSize have been computed.
+ * Post-conditions: Returns false if a stage rejects the image. Otherwise,
+ *          fills searchRegions with the faces found (if any). */
+bool ObjectRecognition::passesCascade(double searchImageRatio,
+                                      const Mat &original) {
+  searchRegions.clear();
+
+  /* Edge density is already known, so it is checked first: */
+  if (searchImageRatio < rejection.minEdgeRatio ||
+      searchImageRatio > rejection.maxEdgeRatio) {
+    return false;
+  }
+
+  /* Colour statistics need one pass over the original image: */
+  if (rejection.minSkinRatio > 0 && original.channels() == 3) {
+    cvtColor(original, scratch.colour, COLOR_BGR2YCrCb);
+    inRange(scratch.colour, minSkin, maxSkin, scratch.skin);
+    double skinRatio =
+        countNonZero(scratch.skin) / static_cast<double>(original.total());
+    if (skinRatio < rejection.minSkinRatio) {
+      return false;
+    }
+  }
+
+  /* The face cascade is the most expensive stage, so it runs last: */
+  if (!rejection.faceCascadePath.empty()) {
+    const Mat *gray = &original;
+    if (original.channels() == 3) {
+      cvtColor(original, scratch.gray, COLOR_BGR2GRAY);
+      gray = &scratch.gray;
+    }
+    Size minFace(rejection.minFaceSize, rejection.minFaceSize);
+    faceCascade.detectMultiScale(*gray, searchRegions, 1.1, 3, 0, minFace);
+    if (searchRegions.empty()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* FUNCTIONS USED FOR ORIENTATION MATCHING */
+
+/* Purpose: To score matches with quantized gradient orientations instead of
+ *          binary edge hits.
+ * Pre-conditions: original is the colour exemplar cropped the same way as the
+ *          edge exemplar. An empty Mat turns orientation matching off.
+ * Post-conditions: Stores the orientation bin of every exemplar edge point and
+ *          enables orientation scoring in match(). A rotation shifts the
+ *          bins by the nearest whole bin (180 / 8 degrees), so it is scored
+ *          up to half a bin off; the neighbouring-bin credit covers that.
+ *          Points with a flat gradient are scored as plain edge hits. */
+void ObjectRecognition::setOrientationMatching(const Mat &original) {
+  if (original.empty()) {
+    orientationMatching = false;
+    return;
+  }
+
+  Mat exemplarBins;
+  quantizeOrientations(original, exemplar, exemplarBins);
+
+  /* Build a lookup table per orientation from every spread bit pattern to its
+   * best similarity, and one for unoriented points that accepts any
+   * orientation: */
+  responseTables.resize(orientationBins + 1);
+  for (int orientation = 0; orientation < orientationBins; ++orientation) {
+    Mat &table = responseTables[orientation];
+    table.create(1, 256, CV_8UC1);
+    uchar next = 1 << ((orientation + 1) % orientationBins);
+    uchar previous =
+        1 << ((orientation + orientationBins - 1) % orientationBins);
+    for (int pattern = 0; pattern < 256; ++pattern) {
+      uchar response = 0;
+      if (pattern & (1 << orientation)) {
+        response = sameBinResponse;
+      } else if (pattern & (next | previous)) {
+        response = nextBinResponse;
+      }
+      table.at<uchar>(0, pattern) = response;
+    }
+  }
+  Mat &anyTable = responseTables[unorientedBin];
+  anyTable.create(1, 256, CV_8UC1);
+  for (int pattern = 0; pattern < 256; ++pattern) {
+    anyTable.at<uchar>(0, pattern) = pattern != 0 ? sameBinResponse : 0;
+  }
+
+  /* Store the bin of every exemplar point once, so scoring a point is a
+   * lookup. Edge points with a flat gradient have no orientation to compare,
+   * so they get the unoriented bin and score like a plain edge hit: */
+  for (int set = 0; set < 2; ++set) {
+    const vector<Point> &points =
+        set == 0 ? exemplarPoints : sparseExemplarPoints;
+    vector<uchar> &bins = set == 0 ? exemplarPointBins : sparsePointBins;
+    bins.clear();
+    for (const Point &point : points) {
+      uchar bit = exemplarBins.at<uchar>(point.y, point.x);
+      uchar bin = 0;
+      for (; bit > 1; bit >>= 1) {
+        bin++;
+      }
+      bins.push_back(bit == 0 ? unorientedBin : bin);
+    }
+  }
+  orientationMatching = true;
+}
+
+/* Purpose: To quantize the gradient orientation of an image into bins.
+ * Pre-conditions: image is a colour or gray-scale image.
+ * Post-conditions: bins holds (1 << bin) for every pixel that is an edge in
+ *          edges and 0 everywhere else. */
+void ObjectRecognition::quantizeOrientations(const Mat &image, const Mat &edges,
+                                             Mat &bins) const {
+  /* Find the gradients of the gray-scale image: */
+  const Mat *gray = &image;
+  if (image.channels() == 3) {
+    cvtColor(image, scratch.gray, COLOR_BGR2GRAY);
+    gray = &scratch.gray;
+  }
+  Mat &dx = scratch.dx;
+  Mat &dy = scratch.dy;
+  Sobel(*gray, dx, CV_32F, 1, 0);
+  Sobel(*gray, dy, CV_32F, 0, 1);
+
+  bins.create(image.rows, image.cols, CV_8UC1);
+  bins.setTo(Scalar(0));
+  const double pi = 3.14159265;
+  for (int row = 0; row < image.rows; ++row) {
+    for (int col = 0; col < image.cols; ++col) {
+      if (edges.at<uchar>(row, col) != edge) {
+        continue;
+      }
+      float gx = dx.at<float>(row, col);
+      float gy = dy.at<float>(row, col);
+      if (fabs(gx) + fabs(gy) < minGradient) {
+        continue;
+      }
+
+      /* Fold the angle into [0, 180) since the edge polarity does not
+       * matter, then find its bin: */
+      double angle = atan2(gy, gx) * (180 / pi);
+      if (angle < 0) {
+        angle += 180;
+      }
+      int bin = static_cast<int>(angle / (180.0 / orientationBins));
+      bins.at<uchar>(row, col) = 1 << (bin % orientationBins);
+    }
+  }
+}
+
+/* Purpose: To build the per-orientation response maps of a search image.
+ * Pre-conditions: original and searchImage have the same dimensions.
+ * Post-conditions: responseMaps[o] holds the similarity of orientation o to
+ *          the orientations spread around every pixel. */
+void ObjectRecognition::computeResponseMaps(const Mat &searchImage,
+                                            const Mat &original) {
+  Mat &bins = scratch.bins;
+  quantizeOrientations(original, searchImage, bins);
+
+  /* Spread each orientation over the same 3x3 neighbourhood that
+   * the backends accept: */
+  Mat &spread = scratch.spread;
+  spread.create(bins.rows, bins.cols, CV_8UC1);
+  spread.setTo(Scalar(0));
+  for (int row = 0; row < bins.rows; ++row) {
+    for (int col = 0; col < bins.cols; ++col) {
+      uchar bit = bins.at<uchar>(row, col);
+      if (bit == 0) {
+        continue;
+      }
+      for (int rowPlus = -1; rowPlus <= 1; ++rowPlus) {
+        for (int colPlus = -1; colPlus <= 1; ++colPlus) {
+          int changeRow = row + rowPlus;
+          int changeCol = col + colPlus;
+          if (changeCol >= 0 && changeCol < spread.cols && changeRow >= 0 &&
+              changeRow < spread.rows) {
+            spread.at<uchar>(changeRow, changeCol) |= bit;
+          }
+        }
+      }
+    }
+  }
+
+  /* Apply the lookup table of every orientation to the whole spread image at
+   * once: */
+  responseMaps.resize(orientationBins + 1);
+  for (int orientation = 0; orientation <= orientationBins; ++orientation) {
+    LUT(spread, responseTables[orientation], responseMaps[orientation]);
+  }
+}
+
 /* Purpose: To calculate the dimension size of a given transformation axis.
  * Pre-conditions: None.
  * Post-conditions: Returns a number that corresponds to an axis' size for
@@ -512,6 +1252,38 @@ int ObjectRecognition::dimensionSize(double transform, double increment) const {
 
 /* HELPER FUNCTIONS */
 
+/* Purpose: Collect the edge points of the exemplar at full and sparse
+ *          resolution.
+ * Pre-conditions: exemplar has been stored.
+ * Post-conditions: Fills exemplarPoints and sparseExemplarPoints. */
+void ObjectRecognition::computeExemplarPoints() {
+  exemplarPoints.clear();
+  sparseExemplarPoints.clear();
+
+  /* Track which sparseStride x sparseStride cells already have a point, so
+   * the sparse set stays spread over the whole exemplar: */
+  int sparseStride = profile.sparseStride;
+  int cellRows = exemplar.rows / sparseStride + 1;
+  int cellCols = exemplar.cols / sparseStride + 1;
+  vector<bool> cellTaken(cellRows * cellCols, false);
+
+  for (int row = 0; row < exemplar.rows; ++row) {
+    for (int col = 0; col < exemplar.cols; ++col) {
+      if (exemplar.at<uchar>(row, col) != edge) {
+        continue;
+      }
+      exemplarPoints.push_back(Point(col, row));
+
+      /* Keep the first edge point found in each cell: */
+      int cell = (row / sparseStride) * cellCols + (col / sparseStride);
+      if (!cellTaken[cell]) {
+        cellTaken[cell] = true;
+        sparseExemplarPoints.push_back(Point(col, row));
+      }
+    }
+  }
+}
+
 /* Purpose: Compute the total amount of edges in an image.
  * Pre-conditions: image is valid.
  * Post-conditions: Returns the number of edges in the image. */
@@ -530,46 +1302,31 @@ int ObjectRecognition::computeEdgeTotals(const Mat &image) const {
   return edgeSum;
 }
 
-/* Purpose: Draw an outline of the match on the searchImage.
- * Pre-conditions: ratio has been computed and it is a good match.
- * Post-conditions: Outputs the image with an outline of the match. */
-void ObjectRecognition::drawMatch(const Mat &image, double ratio, string name) const {
-  /* Create a new image and clone the original: */
-  Mat newImage = image.clone();
-
-  /* Get transformation from the best ratio: */
-  pair<Transformations, pair<int, int>> transformation =
-      bestTransformation[ratio];
-
+/* Purpose: Find the outline of a match on the searchImage.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the box of the transformation at origin, clipped to
+ *          the image. */
+Rect ObjectRecognition::matchBox(const Transformations &combo,
+                                 pair<int, int> origin, Size imageSize) const {
   /* Get the dimensions of the box: */
-  int row = transformation.first.yScale * exemplar.rows;
-  int col = transformation.first.xScale * exemplar.cols;
+  int row = combo.yScale * exemplar.rows;
+  int col = combo.xScale * exemplar.cols;
 
   /* Get the starting point of the box: */
-  int boxRow = transformation.second.first;
-  int boxCol = transformation.second.second;
+  int boxRow = origin.first;
+  int boxCol = origin.second;
 
   /* Get row ranges: */
   int endR = row + boxRow;
-  if (endR > newImage.rows) {
-    endR = newImage.rows - 1;
+  if (endR > imageSize.height) {
+    endR = imageSize.height - 1;
   }
 
   /* Get col ranges: */
   int endC = col + boxCol;
-  if (endC > newImage.cols) {
-    endC = newImage.cols - 1;
+  if (endC > imageSize.width) {
+    endC = imageSize.width - 1;
   }
 
-  /* Draw line segments: */
-  line(newImage, Point(boxCol, boxRow), Point(boxCol, endR), (0, 255, 0), 3);
-  line(newImage, Point(boxCol, endR), Point(endC, endR), (0, 255, 0), 3);
-  line(newImage, Point(endC, endR), Point(endC, boxRow), (0, 255, 0), 3);
-  line(newImage, Point(endC, boxRow), Point(boxCol, boxRow), (0, 255, 0), 3);
-
-  /* Output to the window and save in the directory folder: */
-  namedWindow("Edge-detected Image");
-  imshow("Edge-detected Image", newImage);
-  waitKey(0);
-  imwrite(name + ".jpg", newImage);
+  return Rect(boxCol, boxRow, endC - boxCol, endR - boxRow);
 }
\ No newline at end of file
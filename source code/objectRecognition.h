@@ -7,12 +7,20 @@
  * exemplar image is tested against the search image. If it surpases a certain
  * threshold, a match exists. */
 #pragma once
+#include "edgeStats.h"
+#include "matcherBackend.h"
+#include "resultWriter.h"
+#include "sparseEdgeMap.h"
+#include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+#include <stdexcept>
 
 using namespace cv;
 using namespace std;
@@ -30,23 +38,256 @@ struct Transformations {
   int rotation;
 };
 
-/* Keeps track of the best transformation: */
-static map<double, pair<Transformations, pair<int, int>>> bestTransformation;
+/* Ways of searching the translations of the exemplar: */
+enum TranslationStrategy {
+  /* Pick by the ratio of edges to pixels (profile.translationDensity): */
+  densityRule,
+  /* Divide and conquer on translation (divideAndConquer): */
+  translationSearch,
+  /* Grid of translations with divide and conquer on scale: */
+  gridSearch
+};
+
+/* Structure that stores the parameters of the search. The defaults are the
+ * values the tests were tuned with. The constructor of ObjectRecognition
+ * rejects a profile outside the ranges given below: */
+struct SearchProfile {
+  /* Number of buckets a dimension is split into when dividing. Must be 4,
+   * since divide and conquer probes the middle of 2 x 2 quadrants: */
+  int bucketSize = 4;
+  /* Variable for max size for an exemplar image. Used to calculate the maximum
+   * size of scaling, so it must leave room for at least one scale of the
+   * exemplar: */
+  int maxPixelValue = 750;
+  /* Smallest and largest size of a scale: */
+  double minScale = 0.5;
+  double maxScale = 2;
+  /* Variable used for the increment when scaling an image, above 0: */
+  double incrementScale = 0.10;
+  /* Variables used for the increment when rotating an image. The increment
+   * must be above 0 and the maximum at least half of it: */
+  int incrementRotation = 60;
+  int maxRotation = 180;
+  /* Distance in pixels between translations in the grid search. Must be
+   * above 0: */
+  int gridStride = 25;
+  /* Ratio of edges to pixels above which the translation is found with
+   * divide and conquer instead of the grid: */
+  double translationDensity = 0.05;
+  /* Ratio of edges to pixels above which the dense bound factor is used: */
+  double boundsDensity = 0.06;
+  /* Ratio a candidate must pass per level of divide and conquer: */
+  double denseBoundFactor = 0.20;
+  double sparseBoundFactor = 0.15;
+  /* Ratio the best candidate must pass to be a match: */
+  double matchThreshold = 0.70;
+  /* Cell size used to pick the sparse exemplar points. Must be above 0: */
+  int sparseStride = 4;
+  /* Deepest level of divide and conquer that probes with the sparse exemplar
+   * points: */
+  int sparseLevels = 2;
+  /* Safety margin of a sparse probe, at least 0. A quadrant whose sparse
+   * ratio comes within this of the bound is re-scored at every rotation with
+   * every exemplar point; only one further below is pruned on its sparse
+   * ratio alone: */
+  double sparseMargin = 0.10;
+};
+
+/* Structure that stores the outcome of the last call to match(): */
+struct MatchResult {
+  /* True if the greatest ratio passed the match threshold: */
+  bool found = false;
+  /* Greatest ratio found and the transformation that produced it: */
+  double ratio = 0;
+  Transformations transformation = {0, 0, 0};
+  pair<int, int> origin = make_pair(0, 0);
+  /* Outline of the best transformation on the search image: */
+  Rect box;
+  /* Number of transformations scored: */
+  long long probes = 0;
+  /* False if the latency budget ran out before the search finished. The
+   * result is then the best one found in time: */
+  bool completed = true;
+  /* Strategy the translations were searched with: */
+  TranslationStrategy strategy = densityRule;
+  /* Cost the strategy selector predicted for the search, or -1 without a
+   * selector: */
+  double predictedMs = -1;
+  double predictedProbes = -1;
+  /* True if the result came from the result cache without a search: */
+  bool cached = false;
+  /* Time spent in match(), in milliseconds: */
+  double elapsedMs = 0;
+};
+
+/* Structure that configures the cheap stages run before the edge search. An
+ * image failing any enabled stage is rejected without matching: */
+struct RejectionCascade {
+  /* Range of the ratio of edges to pixels an image must be inside: */
+  double minEdgeRatio = 0;
+  double maxEdgeRatio = 1;
+  /* Smallest ratio of skin-coloured pixels in the original image. 0 turns
+   * the stage off: */
+  double minSkinRatio = 0;
+  /* Path to an OpenCV face cascade (e.g., haarcascade_frontalface_default.xml)
+   * on the local disk. When set, images without a face are rejected and the
+   * search only runs inside the faces that were found: */
+  string faceCascadePath;
+  /* Smallest face, in pixels, the face cascade looks for: */
+  int minFaceSize = 30;
+};
+
+/* Structure that stores one detection of the exemplar in a search image: */
+struct Detection {
+  double score;
+  Transformations transformation;
+  pair<int, int> origin;
+  Rect box;
+};
+
+/* Structure that stores a quadrant that passed the bounds while dividing: */
+struct Candidate {
+  double ratio;
+  pair<int, int> cell;
+};
+
+/* Structure that holds the buffers a call to match() works in. They keep
+ * their capacity between calls, so once warm the search does not allocate: */
+struct SearchScratch {
+  /* Regions and grid translations to search: */
+  vector<Rect> regions;
+  vector<pair<int, int>> origins;
+  vector<pair<int, pair<int, int>>> order;
+  /* Every candidate above the match threshold, before suppression: */
+  vector<Detection> detections;
+  /* Images used to order translations, find skin and find orientations: */
+  Mat edgeMask;
+  Mat edgeSums;
+  Mat colour;
+  Mat skin;
+  Mat gray;
+  Mat dx;
+  Mat dy;
+  Mat bins;
+  Mat spread;
+  /* Offset into the response maps of every transformed exemplar point of
+   * one probe, or -1 outside the image: */
+  vector<int> offsets;
+};
+
+class ResultCache;
+class StrategySelector;
 
 class ObjectRecognition {
 public:
   /* Purpose: Constructor to create object and initialize data members.
    * Pre-conditions: Parameter is a valid image (e.g., not .gif).
-   * Post-conditions: Initializes data members. */
-  ObjectRecognition(const Mat &exemplar);
+   * Post-conditions: Initializes data members. Throws invalid_argument if
+   *          the exemplar is empty or profile is outside the ranges
+   *          documented in SearchProfile. */
+  ObjectRecognition(const Mat &exemplar,
+                    const SearchProfile &profile = SearchProfile());
   /* Purpose: Destructor to remove dynamic memory.
    * Pre-conditions: None.
    * Post-conditions: Deletes struct objects in transformCombinations. */
   ~ObjectRecognition();
   /* Purpose: To perform object recognition on an exemplar and searchImage.
-   * Pre-conditions: searchImage is a valid image (e.g., not .gif).
+   * Pre-conditions: searchImage is a valid image (e.g., not .gif). stats,
+   *          if given, are the statistics trimImage returned for it.
    * Post-conditions: Returns true if the exemplar is found in the image. */
-  bool match(Mat &searchImage, const Mat &original, string name);
+  bool match(Mat &searchImage, const Mat &original, const string &name,
+             const EdgeStats *stats = nullptr);
+  /* Purpose: To get the outcome of the last call to match().
+   * Pre-conditions: None.
+   * Post-conditions: Returns the verdict, best ratio, its transformation and
+   *          whether the search completed. */
+  const MatchResult &getLastResult() const;
+  /* Purpose: To get every detection of the last call to match().
+   * Pre-conditions: Multi-detection is on.
+   * Post-conditions: Returns the detections left after non-maximum
+   *          suppression, from the greatest score down. */
+  const vector<Detection> &getDetections() const;
+  /* Purpose: To collect every candidate above the match threshold instead of
+   *          only the greatest.
+   * Pre-conditions: maxOverlap is between 0 and 1.
+   * Post-conditions: match() keeps the candidates found during its single
+   *          traversal and suppresses boxes that overlap a better one by more
+   *          than maxOverlap (intersection over union). */
+  void setMultiDetection(bool enabled, double maxOverlap = 0.3);
+  /* Purpose: To get the parameters of the search.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the search profile given to the constructor. */
+  const SearchProfile &getSearchProfile() const;
+  /* Purpose: To set where outlined results are sent.
+   * Pre-conditions: writer outlives this object, or is nullptr.
+   * Post-conditions: match() submits every result to writer once the
+   *          verdict is known. nullptr turns saving results off. The writer
+   *          copies the images it keeps, so the original given to match()
+   *          can be reused as soon as match() returns. */
+  void setResultWriter(ResultWriter *writer);
+  /* Purpose: To get where outlined results are sent.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the result writer, or nullptr. */
+  ResultWriter *getResultWriter() const;
+  /* Purpose: To set the cache of results for repeated frames.
+   * Pre-conditions: cache outlives this object and is only used by it, or
+   *          is nullptr. Multi-detection is not switched while cache holds
+   *          results.
+   * Post-conditions: match() returns the cached verdict, box and detections
+   *          of a repeated or near-duplicate frame that passes the rejection
+   *          cascade without searching, and caches the result of every
+   *          completed search. */
+  void setResultCache(ResultCache *cache);
+  /* Purpose: To get the cache of results for repeated frames.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the result cache, or nullptr. */
+  ResultCache *getResultCache() const;
+  /* Purpose: To force how the translations are searched.
+   * Pre-conditions: None.
+   * Post-conditions: match() uses strategy. densityRule (the default) lets
+   *          the strategy selector, if any, or the density rule decide. */
+  void setTranslationStrategy(TranslationStrategy strategy);
+  /* Purpose: To get how the translations are searched.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the forced strategy, or densityRule. */
+  TranslationStrategy getTranslationStrategy() const;
+  /* Purpose: To turn skipping translations far from every edge on or off.
+   * Pre-conditions: None.
+   * Post-conditions: When enabled (the default), the grid search skips the
+   *          translations no transformed exemplar can reach an edge from.
+   *          Disabled, it probes every translation on the grid. */
+  void setCandidatePruning(bool enabled);
+  /* Purpose: To pick the translation strategy from measured cost.
+   * Pre-conditions: selector outlives this object, or is nullptr.
+   * Post-conditions: Unless a strategy is forced, match() searches with the
+   *          strategy selector predicts is cheapest and reports the
+   *          prediction error to it. */
+  void setStrategySelector(StrategySelector *selector);
+  /* Purpose: To pick the backend that scores transformations.
+   * Pre-conditions: None.
+   * Post-conditions: Scores edge matches with the backend called name and
+   *          returns true, or keeps the current backend and returns false if
+   *          there is no such backend. Orientation matching always scores
+   *          with the response maps. The first grid search with a backend
+   *          that does not answer from the spatial hash prints a note saying
+   *          so. */
+  bool setMatcherBackend(const string &name);
+  /* Purpose: To get the backend that scores transformations.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the name of the backend. */
+  string getMatcherBackend() const;
+
+  /* FUNCTIONS USED FOR THE LATENCY BUDGET */
+
+  /* Purpose: To bound the time a call to match() may spend searching.
+   * Pre-conditions: milliseconds is 0 (no limit) or positive.
+   * Post-conditions: match() explores the most promising work first and
+   *          returns the best result found once the budget runs out. */
+  void setLatencyBudget(double milliseconds);
+  /* Purpose: To get the time a call to match() may spend searching.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the budget in milliseconds, or 0 (no limit). */
+  double getLatencyBudget() const;
 
   /* FUNCTIONS USED FOR THE TRANSFORMATION SPACE */
 
@@ -60,7 +301,34 @@ public:
    *          window. */
   void printTransformationSpace() const;
 
+  /* FUNCTIONS USED FOR ORIENTATION MATCHING */
+
+  /* Purpose: To score matches with quantized gradient orientations instead of
+   *          binary edge hits.
+   * Pre-conditions: original is the colour exemplar cropped the same way as
+   *          the edge exemplar. An empty Mat turns orientation matching off.
+   * Post-conditions: Stores the orientation bin of every exemplar edge point
+   *          and enables orientation scoring in match(). A rotation shifts
+   *          the bins by the nearest whole bin (180 / 8 degrees), so it is
+   *          scored up to half a bin off; the neighbouring-bin credit covers
+   *          that. Points with a flat gradient are scored as plain edge
+   *          hits. */
+  void setOrientationMatching(const Mat &original);
+
+  /* FUNCTIONS USED FOR THE REJECTION CASCADE */
+
+  /* Purpose: To set the cheap stages that run before the edge search.
+   * Pre-conditions: faceCascadePath, if set, names a readable cascade file.
+   * Post-conditions: Stores the stages and loads the face cascade. Returns
+   *          false if the face cascade could not be loaded. */
+  bool setRejectionCascade(const RejectionCascade &cascade);
+
 private:
+  /* Purpose: To hand the last result to the writer and print it.
+   * Pre-conditions: lastResult holds the outcome of the search.
+   * Post-conditions: Returns true if the exemplar was found in the image. */
+  bool reportResult(const Mat &original, const string &name);
+
   /* FUNCTIONS USED FOR DIVIDE AND CONQUER */
 
   /* Purpose: Divide and conquer with translations.
@@ -79,6 +347,40 @@ private:
                                pair<int, int> dimensions, double currentCount,
                                double previousCount, int levelOfDivide) const;
 
+  /* Purpose: To order grid translations so the most promising come first.
+   * Pre-conditions: searchImage is the edge-detected search image.
+   * Post-conditions: Sorts origins by the number of edges an unscaled
+   *          exemplar placed there would cover, greatest first. */
+  void orderTranslations(const Mat &searchImage,
+                         vector<pair<int, int>> &origins) const;
+  /* Purpose: To find the best rotation of one scale at a translation.
+   * Pre-conditions: points is exemplarPoints or sparseExemplarPoints and
+   *          rotations is one (xScale, yScale) cell of transformCombinations.
+   * Post-conditions: Returns the greatest ratio over the rotations and sets
+   *          rotation to the one that gave it. */
+  double bestRotation(const Mat &searchImage, const vector<Point> &points,
+                      const vector<Transformations *> &rotations,
+                      pair<int, int> origin, int &rotation) const;
+
+  /* FUNCTION USED FOR THE LATENCY BUDGET */
+
+  /* Purpose: To check if the latency budget has run out.
+   * Pre-conditions: match() has set the deadline.
+   * Post-conditions: Returns true, and marks the search as incomplete, if
+   *          there is a budget and it has run out. */
+  bool deadlinePassed() const;
+
+  /* Purpose: To order candidates from the greatest ratio down.
+   * Pre-conditions: count is at most the size of candidates.
+   * Post-conditions: Sorts the first count candidates in place. */
+  void orderCandidates(Candidate candidates[], int count) const;
+  /* Purpose: To keep track of the best transformation.
+   * Pre-conditions: None.
+   * Post-conditions: Stores the transformation if its ratio is at least the
+   *          best ratio so far. */
+  void recordBest(double ratio, const Transformations &combo,
+                  pair<int, int> origin) const;
+
   /* FUNCTION USED FOR BOUNDS CHECKING */
 
   /* Purpose: To check the bound of a given transformed image.
@@ -89,19 +391,41 @@ private:
   /* FUNCTIONS USED FOR FINDING MATCH EDGES */
 
   /* Purpose: To calculate the count given the transformation.
-   * Pre-conditions: None.
+   * Pre-conditions: points is exemplarPoints or sparseExemplarPoints.
    * Post-conditions: returns the total edges of an transformed exemplar and the
    *          total edge matches at a given point on the image  */
   pair<double, double> getCount(const Mat &searchImage,
+                                const vector<Point> &points,
                                 pair<double, double> scale, int rotation,
                                 pair<int, int> origin) const;
-  /* Purpose: To check the neighbors of a given (row, col) to see if edge.
-   * Pre-conditions: None.
-   * Post-conditions: Returns true if an edge exists.  */
-  bool checkNeighbors(const Mat &searchImage, double row, double col) const;
+
+  /* FUNCTION USED FOR THE REJECTION CASCADE */
+
+  /* Purpose: To run the rejection cascade on a search image.
+   * Pre-conditions: searchEdges and searchSize have been computed.
+   * Post-conditions: Returns false if a stage rejects the image. Otherwise,
+   *          fills searchRegions with the faces found (if any). */
+  bool passesCascade(double searchImageRatio, const Mat &original);
+
+  /* Purpose: To quantize the gradient orientation of an image into bins.
+   * Pre-conditions: image is a colour or gray-scale image.
+   * Post-conditions: bins holds (1 << bin) for every pixel that is an edge in
+   *          edges and 0 everywhere else. */
+  void quantizeOrientations(const Mat &image, const Mat &edges,
+                            Mat &bins) const;
+  /* Purpose: To build the per-orientation response maps of a search image.
+   * Pre-conditions: original and searchImage have the same dimensions.
+   * Post-conditions: responseMaps[o] holds the similarity of orientation o to
+   *          the orientations spread around every pixel. */
+  void computeResponseMaps(const Mat &searchImage, const Mat &original);
 
   /* HELPER FUNCTIONS */
 
+  /* Purpose: Collect the edge points of the exemplar at full and sparse
+   *          resolution.
+   * Pre-conditions: exemplar has been stored.
+   * Post-conditions: Fills exemplarPoints and sparseExemplarPoints. */
+  void computeExemplarPoints();
   /* Purpose: Compute the total amount of edges in an image.
    * Pre-conditions: image is valid.
    * Post-conditions: Returns the number of edges in the image. */
@@ -111,37 +435,121 @@ private:
    * Post-conditions: Returns a number that corresponds to an axis' size for the
    *          transformation space. */
   int dimensionSize(double transform, double increment) const;
-  /* Purpose: Draw an outline of the match on the searchImage.
-   * Pre-conditions: ratio has been computed and it is a good match.
-   * Post-conditions: Outputs the image with an outline of the match. */
-  void drawMatch(const Mat &image, double ratio, string name) const;
+  /* Purpose: Find the outline of a match on the searchImage.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the box of the transformation at origin, clipped
+   *          to the image. */
+  Rect matchBox(const Transformations &combo, pair<int, int> origin,
+               Size imageSize) const;
+  /* Purpose: To remove detections that overlap a better detection.
+   * Pre-conditions: scratch.detections holds the candidates of the search.
+   * Post-conditions: Fills detections from the greatest score down. */
+  void suppressDetections(Size imageSize);
 
   /* EXEMPLAR VARIABLES */
   Mat exemplar;
   double exemplarEdges;
+  /* Every edge point of the exemplar, stored as (col, row): */
+  vector<Point> exemplarPoints;
+  /* Spatially stratified subset of exemplarPoints (one point per
+   * sparseStride x sparseStride cell) used for the coarse probes. Candidates
+   * within profile.sparseMargin of the bounds at the first sparseLevels
+   * levels are re-scored at every rotation with the full point set, so every
+   * stored ratio is a full-resolution ratio: */
+  vector<Point> sparseExemplarPoints;
+
+  /* SEARCH PARAMETERS */
+  SearchProfile profile;
+  /* Writer that outlines and saves results, or nullptr: */
+  ResultWriter *resultWriter = nullptr;
+  /* Cache of results for repeated frames, or nullptr: */
+  ResultCache *resultCache = nullptr;
+  /* Forced translation strategy and the selector that picks one otherwise: */
+  TranslationStrategy translationStrategy = densityRule;
+  StrategySelector *strategySelector = nullptr;
+  /* Number of transformations scored in the current call to match(): */
+  mutable long long probes = 0;
+
+  /* ORIENTATION MATCHING VARIABLES */
+
+  /* True when getCount scores with the response maps: */
+  bool orientationMatching = false;
+  /* Orientation bin of every point of exemplarPoints and
+   * sparseExemplarPoints, in the same order. Points with a flat gradient get
+   * unorientedBin: */
+  vector<uchar> exemplarPointBins;
+  vector<uchar> sparsePointBins;
+  /* One similarity map per orientation bin for the current search image, and
+   * the table from spread bit patterns to similarity that builds each. The
+   * extra last map gives an unoriented point full credit for any edge: */
+  vector<Mat> responseMaps;
+  vector<Mat> responseTables;
+  /* Number of bins the 180 degrees of gradient orientation are split into: */
+  static const int orientationBins = 8;
+  static const int unorientedBin = orientationBins;
+  /* Similarity given to the same bin and to a neighbouring bin. Every other
+   * bin scores 0: */
+  static const int sameBinResponse = 4;
+  static const int nextBinResponse = 2;
+  /* Gradient magnitude below which a pixel has no orientation: */
+  const float minGradient = 10.0f;
+
+  /* REJECTION CASCADE VARIABLES */
+
+  RejectionCascade rejection;
+  CascadeClassifier faceCascade;
+  /* Regions of the search image the search is limited to. Empty means the
+   * whole image: */
+  vector<Rect> searchRegions;
+  /* Skin range in YCrCb: */
+  const Scalar minSkin = Scalar(0, 133, 77);
+  const Scalar maxSkin = Scalar(255, 173, 127);
 
   /* SEARCH IMAGE VARIABLES */
   double searchEdges;
   double searchSize;
+  /* Edge list and spatial hash of a low-density search image. It prunes the
+   * grid translations and is handed to the backend, which answers its
+   * neighbour queries from it if usesSparseMap(): */
+  SparseEdgeMap sparseSearch;
+  /* Backend that scores the edge matches of a transformation, and whether
+   * the note that it ignores the spatial hash has been printed: */
+  MatcherBackend *backend;
+  bool warnedDenseBackend = false;
+  /* Side of a spatial hash cell in pixels: */
+  const int hashCellSize = 8;
+  /* Whether the grid search skips translations that cannot reach an edge: */
+  bool candidatePruning = true;
+
+  /* RESULT VARIABLES */
+  MatchResult lastResult;
+  /* Best ratio, transformation and origin of the current search: */
+  mutable double bestRatio = -1;
+  mutable Transformations bestCombo = {0, 0, 0};
+  mutable pair<int, int> bestOrigin = make_pair(0, 0);
+  /* Multi-detection settings and the detections of the last search: */
+  bool multiDetection = false;
+  double maxDetectionOverlap = 0.3;
+  vector<Detection> detections;
+  /* Buffers reused by every call to match(): */
+  mutable SearchScratch scratch;
+
+  /* LATENCY BUDGET VARIABLES */
+
+  /* Budget per call to match() in milliseconds. 0 means no limit: */
+  double latencyBudget = 0;
+  chrono::steady_clock::time_point deadline;
+  /* Set once the deadline has been seen during a search: */
+  mutable bool timedOut = false;
 
   /* TRANSFORMATION SPACE VARIABLES */
 
   /* 3D vector that stores rotation and xScale and yScale combinations.
    * Used for transformation space: */
   vector<vector<vector<Transformations *>>> transformCombinations;
-  /* Number of buckets: */
-  const int bucketSize = 4;
-  /* Variable for max size for an exemplar image. Used to calculate the maximum
-   * size of scaling: */
-  const int maxPixelValue = 750;
-  /* Max size of a scale: */
-  const int maxScale = 2;
   /* Stores the maximum size of scaling an image: */
   double maxXScale;
   double maxYScale;
-  /* Variable used for the increment when scaling an image: */
-  const double incrementScale = 0.10;
-  /* Variables used for the increment when rotating an image: */
-  const int incrementRotation = 60;
-  const int maxRotation = 180;
+  /* Furthest a point of any transformed exemplar lies from its origin: */
+  double transformReach = 0;
 };
\ No newline at end of file
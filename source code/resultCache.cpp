@@ -0,0 +1,163 @@
+/* Description: A cache of match results keyed by a fingerprint of the
+ * downsampled edge map of a search image. Repeated and near-duplicate frames
+ * (e.g., from a static camera) get the cached verdict and box without a
+ * search, with the box rescaled to the size of the new frame. The cache holds
+ * a bounded number of entries and evicts the least recently used. */
+#include "resultCache.h"
+
+/* Purpose: Constructor to create an empty cache.
+ * Pre-conditions: capacity is positive, tolerance is between 0 and 256 and
+ *          sizeTolerance is at least 0.
+ * Post-conditions: Creates a cache holding at most capacity results, where
+ *          fingerprints differing in at most tolerance bits, of images whose
+ *          rows and cols differ by at most sizeTolerance pixels, are treated
+ *          as the same frame. A tolerance of 0 treats only an exact repeat
+ *          (the same dimensions and downsampled edge map) as the same
+ *          frame. */
+ResultCache::ResultCache(int capacity, int tolerance, int sizeTolerance)
+    : capacity(capacity), tolerance(tolerance), sizeTolerance(sizeTolerance),
+      hits(0), misses(0) {}
+
+/* Purpose: To compute the fingerprint of an edge-detected image.
+ * Pre-conditions: image is a single channel edge-detected image.
+ * Post-conditions: Returns its fingerprint. */
+EdgeFingerprint ResultCache::fingerprint(const Mat &image) {
+  EdgeFingerprint print = {{0, 0, 0, 0}, 0, image.rows, image.cols};
+  if (image.empty()) {
+    return print;
+  }
+
+  /* Average the edges of each cell, then keep which cells are above the
+   * average cell, and hash every average (64-bit FNV-1a) for exact repeats:
+   */
+  resize(image, cells, Size(gridSize, gridSize), 0, 0, INTER_AREA);
+  double average = mean(cells)[0];
+  print.exact = 14695981039346656037ULL;
+  for (int cell = 0; cell < gridSize * gridSize; ++cell) {
+    uchar value = cells.at<uchar>(cell / gridSize, cell % gridSize);
+    if (value > average) {
+      print.bits[cell / 64] |= uint64_t(1) << (cell % 64);
+    }
+    print.exact = (print.exact ^ value) * 1099511628211ULL;
+  }
+  return print;
+}
+
+/* Purpose: To find the result of the same or a near-duplicate frame.
+ * Pre-conditions: None.
+ * Post-conditions: Returns true and sets result and detections if a cached
+ *          fingerprint is the same frame, with their boxes and origins
+ *          rescaled from the cached frame to the dimensions of print. The
+ *          entry becomes the most recently used. */
+bool ResultCache::lookup(const EdgeFingerprint &print, MatchResult &result,
+                         vector<Detection> &detections) {
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (sameFrame(it->first, print)) {
+      entries.splice(entries.begin(), entries, it);
+      const EdgeFingerprint &cached = entries.front().first;
+      result = entries.front().second.result;
+      detections = entries.front().second.detections;
+
+      /* A near-duplicate trimmed to another size has its outline moved and
+       * stretched with the frame: */
+      double rowScale =
+          cached.rows > 0 ? print.rows / static_cast<double>(cached.rows) : 1;
+      double colScale =
+          cached.cols > 0 ? print.cols / static_cast<double>(cached.cols) : 1;
+      rescale(result.box, result.origin, rowScale, colScale);
+      for (Detection &detection : detections) {
+        rescale(detection.box, detection.origin, rowScale, colScale);
+      }
+      hits++;
+      return true;
+    }
+  }
+  misses++;
+  return false;
+}
+
+/* Purpose: To store the result of a frame.
+ * Pre-conditions: None.
+ * Post-conditions: Stores the result and detections as the most recently used
+ *          entry, evicting the least recently used one if the cache is full. */
+void ResultCache::insert(const EdgeFingerprint &print,
+                         const MatchResult &result,
+                         const vector<Detection> &detections) {
+  if (static_cast<int>(entries.size()) >= capacity) {
+    entries.pop_back();
+  }
+  CachedResult cached;
+  cached.result = result;
+  cached.detections = detections;
+  entries.push_front(make_pair(print, cached));
+}
+
+/* Purpose: To get the share of lookups that found a result.
+ * Pre-conditions: None.
+ * Post-conditions: Returns hits / lookups, or 0 before any lookup. */
+double ResultCache::hitRate() const {
+  long long lookups = hits + misses;
+  if (lookups == 0) {
+    return 0;
+  }
+  return hits / static_cast<double>(lookups);
+}
+
+/* Purpose: To get the number of lookups that found a result.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the count since the cache was created. */
+long long ResultCache::getHits() const { return hits; }
+
+/* Purpose: To get the number of lookups that missed.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the count since the cache was created. */
+long long ResultCache::getMisses() const { return misses; }
+
+/* Purpose: To check if two fingerprints are of the same frame.
+ * Pre-conditions: None.
+ * Post-conditions: Returns true if they are equal with a tolerance of 0, or
+ *          otherwise within tolerance bits and sizeTolerance pixels. */
+bool ResultCache::sameFrame(const EdgeFingerprint &a,
+                            const EdgeFingerprint &b) const {
+  if (tolerance == 0) {
+    return a.exact == b.exact && a.rows == b.rows && a.cols == b.cols &&
+           distance(a, b) == 0;
+  }
+  return distance(a, b) <= tolerance;
+}
+
+/* Purpose: To move and stretch an outline to a frame of another size.
+ * Pre-conditions: None.
+ * Post-conditions: Scales box and origin (row, col) by rowScale and
+ *          colScale. */
+void ResultCache::rescale(Rect &box, pair<int, int> &origin, double rowScale,
+                          double colScale) const {
+  box = Rect(cvRound(box.x * colScale), cvRound(box.y * rowScale),
+             cvRound(box.width * colScale), cvRound(box.height * rowScale));
+  origin = make_pair(cvRound(origin.first * rowScale),
+                     cvRound(origin.second * colScale));
+}
+
+/* Purpose: To count the bits two fingerprints differ in.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the Hamming distance, or more than any tolerance if
+ *          the dimensions differ by more than sizeTolerance. */
+int ResultCache::distance(const EdgeFingerprint &a,
+                          const EdgeFingerprint &b) const {
+  /* Trimming near-duplicate frames can leave a few pixels more or less: */
+  if (abs(a.rows - b.rows) > sizeTolerance ||
+      abs(a.cols - b.cols) > sizeTolerance) {
+    return gridSize * gridSize + 1;
+  }
+
+  int bits = 0;
+  for (int word = 0; word < 4; ++word) {
+    uint64_t differ = a.bits[word] ^ b.bits[word];
+    /* Clear the lowest set bit until none are left: */
+    while (differ != 0) {
+      differ &= differ - 1;
+      bits++;
+    }
+  }
+  return bits;
+}
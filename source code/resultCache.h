@@ -0,0 +1,102 @@
+/* Description: A cache of match results keyed by a fingerprint of the
+ * downsampled edge map of a search image. Repeated and near-duplicate frames
+ * (e.g., from a static camera) get the cached verdict and box without a
+ * search, with the box rescaled to the size of the new frame. The cache holds
+ * a bounded number of entries and evicts the least recently used. */
+#pragma once
+#include "objectRecognition.h"
+#include <cstdint>
+#include <list>
+
+/* Structure that stores the fingerprint of an edge-detected image: one bit
+ * per cell of a 16x16 grid, set if the cell has more edges than the average
+ * cell, a hash of the exact edge average of every cell, and the image
+ * dimensions: */
+struct EdgeFingerprint {
+  uint64_t bits[4];
+  uint64_t exact;
+  int rows;
+  int cols;
+};
+
+/* Structure that stores what a search found: the result and, with
+ * multi-detection on, every detection kept: */
+struct CachedResult {
+  MatchResult result;
+  vector<Detection> detections;
+};
+
+class ResultCache {
+public:
+  /* Purpose: Constructor to create an empty cache.
+   * Pre-conditions: capacity is positive, tolerance is between 0 and 256 and
+   *          sizeTolerance is at least 0.
+   * Post-conditions: Creates a cache holding at most capacity results, where
+   *          fingerprints differing in at most tolerance bits, of images
+   *          whose rows and cols differ by at most sizeTolerance pixels, are
+   *          treated as the same frame. A tolerance of 0 treats only an exact
+   *          repeat (the same dimensions and downsampled edge map) as the
+   *          same frame. */
+  ResultCache(int capacity = 64, int tolerance = 0, int sizeTolerance = 4);
+
+  /* Purpose: To compute the fingerprint of an edge-detected image.
+   * Pre-conditions: image is a single channel edge-detected image.
+   * Post-conditions: Returns its fingerprint. */
+  EdgeFingerprint fingerprint(const Mat &image);
+  /* Purpose: To find the result of the same or a near-duplicate frame.
+   * Pre-conditions: None.
+   * Post-conditions: Returns true and sets result and detections if a cached
+   *          fingerprint is the same frame, with their boxes and origins
+   *          rescaled from the cached frame to the dimensions of print. The
+   *          entry becomes the most recently used. */
+  bool lookup(const EdgeFingerprint &print, MatchResult &result,
+              vector<Detection> &detections);
+  /* Purpose: To store the result of a frame.
+   * Pre-conditions: None.
+   * Post-conditions: Stores the result and detections as the most recently
+   *          used entry, evicting the least recently used one if the cache is
+   *          full. */
+  void insert(const EdgeFingerprint &print, const MatchResult &result,
+              const vector<Detection> &detections);
+
+  /* Purpose: To get the share of lookups that found a result.
+   * Pre-conditions: None.
+   * Post-conditions: Returns hits / lookups, or 0 before any lookup. */
+  double hitRate() const;
+  /* Purpose: To get the number of lookups that found or missed a result.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the counts since the cache was created. */
+  long long getHits() const;
+  long long getMisses() const;
+
+private:
+  /* Purpose: To check if two fingerprints are of the same frame.
+   * Pre-conditions: None.
+   * Post-conditions: Returns true if they are equal with a tolerance of 0,
+   *          or otherwise within tolerance bits and sizeTolerance pixels. */
+  bool sameFrame(const EdgeFingerprint &a, const EdgeFingerprint &b) const;
+  /* Purpose: To move and stretch an outline to a frame of another size.
+   * Pre-conditions: None.
+   * Post-conditions: Scales box and origin (row, col) by rowScale and
+   *          colScale. */
+  void rescale(Rect &box, pair<int, int> &origin, double rowScale,
+               double colScale) const;
+  /* Purpose: To count the bits two fingerprints differ in.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the Hamming distance, or more than any tolerance
+   *          if the dimensions differ by more than sizeTolerance. */
+  int distance(const EdgeFingerprint &a, const EdgeFingerprint &b) const;
+
+  /* Number of cells per side of the fingerprint grid: */
+  static const int gridSize = 16;
+  /* Downsampled edge map, reused between frames: */
+  Mat cells;
+
+  /* Entries from the most to the least recently used: */
+  list<pair<EdgeFingerprint, CachedResult>> entries;
+  int capacity;
+  int tolerance;
+  int sizeTolerance;
+  long long hits;
+  long long misses;
+};
@@ -0,0 +1,137 @@
+/* Description: A class that outlines match results on their original images
+ * and saves them as JPEG files on a background thread. Results wait in a
+ * bounded queue and can be sampled (e.g., only positives, or 1 in N), so
+ * match() returns as soon as the verdict is known. */
+#include "resultWriter.h"
+
+/* Purpose: Constructor to start the background writer.
+ * Pre-conditions: everyN and queueCapacity are positive.
+ * Post-conditions: Starts the thread that saves results. */
+ResultWriter::ResultWriter(const WriterOptions &options)
+    : options(options), stopping(false), busy(false), submitted(0),
+      written(0), dropped(0) {
+  worker = thread(&ResultWriter::run, this);
+}
+
+/* Purpose: Destructor to stop the background writer.
+ * Pre-conditions: None.
+ * Post-conditions: Saves every queued result, then stops the thread. */
+ResultWriter::~ResultWriter() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+/* Purpose: To queue a result to be outlined and saved.
+ * Pre-conditions: original is the image the box was found in.
+ * Post-conditions: Returns true if the result was queued, false if it was
+ *          sampled out or the queue was full. */
+bool ResultWriter::submit(const Mat &original, Rect box, bool found,
+                          const string &name) {
+  if (options.positivesOnly && !found) {
+    return false;
+  }
+
+  {
+    lock_guard<mutex> guard(lock);
+    /* Keep 1 in every N results: */
+    if (submitted++ % options.everyN != 0) {
+      return false;
+    }
+    /* Never block the caller on a full queue: */
+    if (static_cast<int>(queue.size()) >= options.queueCapacity) {
+      dropped++;
+      return false;
+    }
+    /* Copy only the results that are kept. The caller may reuse original,
+     * e.g., for the next camera frame, while the copy is being saved: */
+    Job job;
+    job.image = original.clone();
+    job.box = box;
+    job.name = name;
+    queue.push_back(job);
+  }
+  wake.notify_one();
+  return true;
+}
+
+/* Purpose: To wait for the queued results to be saved.
+ * Pre-conditions: None.
+ * Post-conditions: Returns once the queue is empty and nothing is being
+ *          saved. */
+void ResultWriter::flush() {
+  unique_lock<mutex> guard(lock);
+  idle.wait(guard, [this] { return queue.empty() && !busy; });
+}
+
+/* Purpose: To get the number of results saved.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the count since the writer started. */
+long long ResultWriter::getWritten() const {
+  lock_guard<mutex> guard(lock);
+  return written;
+}
+
+/* Purpose: To get the number of results dropped on a full queue.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the count since the writer started. */
+long long ResultWriter::getDropped() const {
+  lock_guard<mutex> guard(lock);
+  return dropped;
+}
+
+/* Purpose: To save queued results until the writer stops.
+ * Pre-conditions: None.
+ * Post-conditions: Runs on the background thread. */
+void ResultWriter::run() {
+  unique_lock<mutex> guard(lock);
+  while (true) {
+    wake.wait(guard, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      /* Stopping with nothing left to save: */
+      return;
+    }
+
+    Job job = queue.front();
+    queue.pop_front();
+    busy = true;
+
+    /* Draw and encode without holding the lock, so submit() never waits on
+     * the encoder: */
+    guard.unlock();
+    write(job);
+    guard.lock();
+
+    written++;
+    busy = false;
+    if (queue.empty()) {
+      idle.notify_all();
+    }
+  }
+}
+
+/* Purpose: To outline a result and save it.
+ * Pre-conditions: None.
+ * Post-conditions: Writes <directory><name>.jpg. */
+void ResultWriter::write(Job &job) const {
+  /* Draw into the copy submit() made: */
+  Mat &newImage = job.image;
+
+  int boxRow = job.box.y;
+  int boxCol = job.box.x;
+  int endR = job.box.y + job.box.height;
+  int endC = job.box.x + job.box.width;
+
+  /* Draw line segments: */
+  Scalar green(0, 255, 0);
+  line(newImage, Point(boxCol, boxRow), Point(boxCol, endR), green, 3);
+  line(newImage, Point(boxCol, endR), Point(endC, endR), green, 3);
+  line(newImage, Point(endC, endR), Point(endC, boxRow), green, 3);
+  line(newImage, Point(endC, boxRow), Point(boxCol, boxRow), green, 3);
+
+  /* Save in the directory folder: */
+  imwrite(options.directory + job.name + ".jpg", newImage);
+}
@@ -0,0 +1,93 @@
+/* Description: A class that outlines match results on their original images
+ * and saves them as JPEG files on a background thread. Results wait in a
+ * bounded queue and can be sampled (e.g., only positives, or 1 in N), so
+ * match() returns as soon as the verdict is known. */
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <string>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+/* Structure that configures which results are saved and where: */
+struct WriterOptions {
+  /* Only save results where a mask was found: */
+  bool positivesOnly = false;
+  /* Save 1 in every N results that pass positivesOnly: */
+  int everyN = 1;
+  /* Number of results that may wait to be saved. Results submitted while the
+   * queue is full are dropped instead of blocking the caller: */
+  int queueCapacity = 8;
+  /* Folder the images are saved in, ending in a separator (or empty for the
+   * default directory): */
+  string directory;
+};
+
+class ResultWriter {
+public:
+  /* Purpose: Constructor to start the background writer.
+   * Pre-conditions: everyN and queueCapacity are positive.
+   * Post-conditions: Starts the thread that saves results. */
+  ResultWriter(const WriterOptions &options = WriterOptions());
+  /* Purpose: Destructor to stop the background writer.
+   * Pre-conditions: None.
+   * Post-conditions: Saves every queued result, then stops the thread. */
+  ~ResultWriter();
+
+  /* Purpose: To queue a result to be outlined and saved.
+   * Pre-conditions: original is the image the box was found in. A kept
+   *          result is copied, so the caller may reuse original at once.
+   * Post-conditions: Returns true if the result was queued, false if it was
+   *          sampled out or the queue was full. */
+  bool submit(const Mat &original, Rect box, bool found, const string &name);
+  /* Purpose: To wait for the queued results to be saved.
+   * Pre-conditions: None.
+   * Post-conditions: Returns once the queue is empty and nothing is being
+   *          saved. */
+  void flush();
+
+  /* Purpose: To get the number of results saved and dropped.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the counts since the writer started. */
+  long long getWritten() const;
+  long long getDropped() const;
+
+private:
+  /* Structure that stores a result waiting to be saved: */
+  struct Job {
+    Mat image;
+    Rect box;
+    string name;
+  };
+
+  /* Purpose: To save queued results until the writer stops.
+   * Pre-conditions: None.
+   * Post-conditions: Runs on the background thread. */
+  void run();
+  /* Purpose: To outline a result and save it.
+   * Pre-conditions: None.
+   * Post-conditions: Writes <directory><name>.jpg. */
+  void write(Job &job) const;
+
+  WriterOptions options;
+
+  /* QUEUE VARIABLES */
+  deque<Job> queue;
+  mutable mutex lock;
+  condition_variable wake;
+  condition_variable idle;
+  bool stopping;
+  bool busy;
+  thread worker;
+
+  /* COUNTERS */
+  long long submitted;
+  long long written;
+  long long dropped;
+};
@@ -0,0 +1,288 @@
+/* Description: A vectorized scoring backend. Several exemplar points of one
+ * transformation are transformed at once, their pixels are gathered from a
+ * padded, pre-dilated copy of the search image and the hits are counted with
+ * a popcount of the comparison mask. The widest instruction set the processor
+ * supports (AVX2, then SSE2) is picked at runtime, with a scalar loop for
+ * other processors and for the points left over after the last full batch. */
+#include "simdBackend.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_BACKEND_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/* MSVC compiles intrinsics of any instruction set, while GCC and Clang need
+ * the functions that use AVX2 to be marked: */
+#if defined(SIMD_BACKEND_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define TARGET_AVX2
+#endif
+
+/* The kernels load a Point as two adjacent ints, x then y: */
+static_assert(sizeof(Point) == 2 * sizeof(int), "Point must be two ints");
+
+/* Structure that stores one transformation and the map it is scored on: */
+struct ProbeKernel {
+  /* Transformation, in the order the reference backend applies it: */
+  double cosVal;
+  double sinVal;
+  double rowScale;
+  double colScale;
+  double rowOrigin;
+  double colOrigin;
+
+  /* Padded dilated map, its row stride and its dimensions: */
+  const uchar *map;
+  int stride;
+  unsigned rows;
+  unsigned cols;
+};
+
+/* Purpose: To score points one at a time.
+ * Pre-conditions: first <= points.size().
+ * Post-conditions: Returns the hits of points[first] onwards. */
+static int scoreScalar(const vector<Point> &points, size_t first,
+                       const ProbeKernel &kernel) {
+  int count = 0;
+  for (size_t i = first; i < points.size(); ++i) {
+    double newRow = ((kernel.sinVal * points[i].x) +
+                     (kernel.cosVal * points[i].y)) *
+                        kernel.rowScale +
+                    kernel.rowOrigin;
+    double newCol = ((kernel.cosVal * points[i].x) +
+                     (-kernel.sinVal * points[i].y)) *
+                        kernel.colScale +
+                    kernel.colOrigin;
+
+    /* A pixel truncated to (row, col) is at (row + 1, col + 1): */
+    unsigned row = static_cast<unsigned>(static_cast<int>(newRow) + 1);
+    unsigned col = static_cast<unsigned>(static_cast<int>(newCol) + 1);
+    if (row < kernel.rows && col < kernel.cols) {
+      count += kernel.map[row * kernel.stride + col];
+    }
+  }
+  return count;
+}
+
+#if defined(SIMD_BACKEND_X86)
+
+/* Purpose: To score points two at a time with SSE2.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the hits of the first done points, where done is
+ *          the largest multiple of 2 not above points.size(). */
+static int scoreSse(const vector<Point> &points, const ProbeKernel &kernel,
+                    size_t &done) {
+  const __m128d cosV = _mm_set1_pd(kernel.cosVal);
+  const __m128d sinV = _mm_set1_pd(kernel.sinVal);
+  const __m128d negSinV = _mm_set1_pd(-kernel.sinVal);
+  const __m128d rowScale = _mm_set1_pd(kernel.rowScale);
+  const __m128d colScale = _mm_set1_pd(kernel.colScale);
+  const __m128d rowOrigin = _mm_set1_pd(kernel.rowOrigin);
+  const __m128d colOrigin = _mm_set1_pd(kernel.colOrigin);
+  const __m128i one = _mm_set1_epi32(1);
+  const int *source = reinterpret_cast<const int *>(points.data());
+
+  int count = 0;
+  size_t i = 0;
+  for (; i + 2 <= points.size(); i += 2) {
+    /* (x0, y0, x1, y1) to x = (x0, x1) and y = (y0, y1): */
+    __m128i twoPoints = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(source + 2 * i));
+    __m128i split = _mm_shuffle_epi32(twoPoints, _MM_SHUFFLE(3, 1, 2, 0));
+    __m128d x = _mm_cvtepi32_pd(split);
+    __m128d y = _mm_cvtepi32_pd(_mm_unpackhi_epi64(split, split));
+
+    __m128d newRow = _mm_add_pd(
+        _mm_mul_pd(_mm_add_pd(_mm_mul_pd(sinV, x), _mm_mul_pd(cosV, y)),
+                   rowScale),
+        rowOrigin);
+    __m128d newCol = _mm_add_pd(
+        _mm_mul_pd(_mm_add_pd(_mm_mul_pd(cosV, x), _mm_mul_pd(negSinV, y)),
+                   colScale),
+        colOrigin);
+    __m128i rows = _mm_add_epi32(_mm_cvttpd_epi32(newRow), one);
+    __m128i cols = _mm_add_epi32(_mm_cvttpd_epi32(newCol), one);
+
+    /* SSE2 has no gather, so look the two pixels up one at a time: */
+    for (int lane = 0; lane < 2; ++lane) {
+      unsigned row = static_cast<unsigned>(_mm_cvtsi128_si32(rows));
+      unsigned col = static_cast<unsigned>(_mm_cvtsi128_si32(cols));
+      if (row < kernel.rows && col < kernel.cols) {
+        count += kernel.map[row * kernel.stride + col];
+      }
+      rows = _mm_srli_si128(rows, 4);
+      cols = _mm_srli_si128(cols, 4);
+    }
+  }
+  done = i;
+  return count;
+}
+
+/* Purpose: To score points four at a time with AVX2.
+ * Pre-conditions: The processor supports AVX2.
+ * Post-conditions: Returns the hits of the first done points, where done is
+ *          the largest multiple of 4 not above points.size(). */
+TARGET_AVX2 static int scoreAvx2(const vector<Point> &points,
+                                 const ProbeKernel &kernel, size_t &done) {
+  const __m256d cosV = _mm256_set1_pd(kernel.cosVal);
+  const __m256d sinV = _mm256_set1_pd(kernel.sinVal);
+  const __m256d negSinV = _mm256_set1_pd(-kernel.sinVal);
+  const __m256d rowScale = _mm256_set1_pd(kernel.rowScale);
+  const __m256d colScale = _mm256_set1_pd(kernel.colScale);
+  const __m256d rowOrigin = _mm256_set1_pd(kernel.rowOrigin);
+  const __m256d colOrigin = _mm256_set1_pd(kernel.colOrigin);
+  const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i lastRow = _mm_set1_epi32(static_cast<int>(kernel.rows) - 1);
+  const __m128i lastCol = _mm_set1_epi32(static_cast<int>(kernel.cols) - 1);
+  const __m128i stride = _mm_set1_epi32(kernel.stride);
+  const __m128i lowByte = _mm_set1_epi32(0xFF);
+  const __m128i zero = _mm_setzero_si128();
+  const int *map = reinterpret_cast<const int *>(kernel.map);
+  const int *source = reinterpret_cast<const int *>(points.data());
+
+  int count = 0;
+  size_t i = 0;
+  for (; i + 4 <= points.size(); i += 4) {
+    /* (x0, y0, ..., x3, y3) to x = (x0, ..., x3) and y = (y0, ..., y3): */
+    __m256i four = _mm256_permutevar8x32_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + 2 * i)),
+        deinterleave);
+    __m256d x = _mm256_cvtepi32_pd(_mm256_castsi256_si128(four));
+    __m256d y = _mm256_cvtepi32_pd(_mm256_extracti128_si256(four, 1));
+
+    /* Transform with the same operations in the same order as the reference
+     * backend, so every lane truncates to the same pixel: */
+    __m256d newRow = _mm256_add_pd(
+        _mm256_mul_pd(
+            _mm256_add_pd(_mm256_mul_pd(sinV, x), _mm256_mul_pd(cosV, y)),
+            rowScale),
+        rowOrigin);
+    __m256d newCol = _mm256_add_pd(
+        _mm256_mul_pd(
+            _mm256_add_pd(_mm256_mul_pd(cosV, x), _mm256_mul_pd(negSinV, y)),
+            colScale),
+        colOrigin);
+    __m128i rows = _mm_add_epi32(_mm256_cvttpd_epi32(newRow), one);
+    __m128i cols = _mm_add_epi32(_mm256_cvttpd_epi32(newCol), one);
+
+    /* A lane is inside the padded map if, as unsigned, it is at most the
+     * last row (col): */
+    __m128i inside = _mm_and_si128(
+        _mm_cmpeq_epi32(_mm_min_epu32(rows, lastRow), rows),
+        _mm_cmpeq_epi32(_mm_min_epu32(cols, lastCol), cols));
+
+    /* Gather the pixels of the lanes inside the map and count the hits: */
+    __m128i index = _mm_add_epi32(_mm_mullo_epi32(rows, stride), cols);
+    __m128i pixels = _mm_mask_i32gather_epi32(zero, map, index, inside, 1);
+    __m128i hits = _mm_cmpgt_epi32(_mm_and_si128(pixels, lowByte), zero);
+    count += _mm_popcnt_u32(
+        static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(hits))));
+  }
+  done = i;
+  return count;
+}
+
+#endif
+
+/* Purpose: Constructor to pick the instruction set.
+ * Pre-conditions: None.
+ * Post-conditions: Creates a backend that scores with the widest instruction
+ *          set both the processor and maxLevel allow. */
+SimdBackend::SimdBackend(SimdLevel maxLevel)
+    : level(min(detectLevel(), maxLevel)) {}
+
+/* Purpose: To get the name the backend is created with.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the name of the backend. */
+string SimdBackend::name() const { return "simd"; }
+
+/* Purpose: To get whether the backend answers from the spatial hash.
+ * Pre-conditions: None.
+ * Post-conditions: Returns false: the kernels gather from a dense dilated
+ *          map. */
+bool SimdBackend::usesSparseMap() const { return false; }
+
+/* Purpose: To get the instruction set the backend scores with.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the instruction set. */
+SimdLevel SimdBackend::getLevel() const { return level; }
+
+/* Purpose: To find the widest instruction set of the processor.
+ * Pre-conditions: None.
+ * Post-conditions: Returns avx2Level if the processor and operating system
+ *          support AVX2, sseLevel on other x86-64 processors and scalarLevel
+ *          otherwise. */
+SimdLevel SimdBackend::detectLevel() {
+#if defined(SIMD_BACKEND_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return sseLevel;
+  }
+  /* AVX2 needs the processor to support it and the operating system to save
+   * the AVX registers: */
+  __cpuid(info, 1);
+  bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+  __cpuidex(info, 7, 0);
+  bool avx2 = (info[1] & (1 << 5)) != 0;
+  if (osSavesAvx && avx2 && (_xgetbv(0) & 6) == 6) {
+    return avx2Level;
+  }
+  return sseLevel;
+#elif defined(SIMD_BACKEND_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+    return avx2Level;
+  }
+  return sseLevel;
+#else
+  return scalarLevel;
+#endif
+}
+
+/* Purpose: To prepare the backend for a search image.
+ * Pre-conditions: searchImage is an edge-detected image.
+ * Post-conditions: dilated holds 1 at every padded (row + 1, col + 1) within
+ *          one pixel of an edge, and 0 elsewhere. */
+void SimdBackend::prepare(const Mat &searchImage, int edgeValue,
+                          const SparseEdgeMap * /* sparseMap */) {
+  /* One extra row keeps the 4-byte gathers inside the buffer: */
+  dilateEdges(searchImage, edgeValue, 1, dilated);
+}
+
+/* Purpose: To count the edge matches of a transformed exemplar.
+ * Pre-conditions: prepare() has been called. points are (col, row).
+ * Post-conditions: Returns the same count as the reference backend. */
+int SimdBackend::score(const vector<Point> &points,
+                       pair<double, double> scale, int rotation,
+                       pair<int, int> origin) const {
+  const double pi = 3.14159265;
+  ProbeKernel kernel;
+  kernel.cosVal = cos(rotation * (pi / 180));
+  kernel.sinVal = sin(rotation * (pi / 180));
+  kernel.rowScale = scale.second;
+  kernel.colScale = scale.first;
+  kernel.rowOrigin = origin.first;
+  kernel.colOrigin = origin.second;
+  kernel.map = dilated.ptr<uchar>(0);
+  kernel.stride = static_cast<int>(dilated.step);
+  /* The extra row is only there for the gathers, not for lookups: */
+  kernel.rows = static_cast<unsigned>(dilated.rows - 1);
+  kernel.cols = static_cast<unsigned>(dilated.cols);
+
+  int count = 0;
+  size_t done = 0;
+#if defined(SIMD_BACKEND_X86)
+  if (level == avx2Level) {
+    count = scoreAvx2(points, kernel, done);
+  } else if (level == sseLevel) {
+    count = scoreSse(points, kernel, done);
+  }
+#endif
+  return count + scoreScalar(points, done, kernel);
+}
@@ -0,0 +1,45 @@
+/* Description: A vectorized scoring backend. Several exemplar points of one
+ * transformation are transformed at once, their pixels are gathered from a
+ * padded, pre-dilated copy of the search image and the hits are counted with
+ * a popcount of the comparison mask. The widest instruction set the processor
+ * supports (AVX2, then SSE2) is picked at runtime, with a scalar loop for
+ * other processors and for the points left over after the last full batch. */
+#pragma once
+#include "matcherBackend.h"
+
+/* Instruction sets the backend can score with, from narrowest to widest: */
+enum SimdLevel { scalarLevel, sseLevel, avx2Level };
+
+class SimdBackend : public MatcherBackend {
+public:
+  /* Purpose: Constructor to pick the instruction set.
+   * Pre-conditions: None.
+   * Post-conditions: Creates a backend that scores with the widest
+   *          instruction set both the processor and maxLevel allow. */
+  SimdBackend(SimdLevel maxLevel = avx2Level);
+
+  string name() const override;
+  bool usesSparseMap() const override;
+  void prepare(const Mat &searchImage, int edgeValue,
+               const SparseEdgeMap *sparseMap) override;
+  int score(const vector<Point> &points, pair<double, double> scale,
+            int rotation, pair<int, int> origin) const override;
+
+  /* Purpose: To get the instruction set the backend scores with.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the instruction set. */
+  SimdLevel getLevel() const;
+  /* Purpose: To find the widest instruction set of the processor.
+   * Pre-conditions: None.
+   * Post-conditions: Returns avx2Level if the processor and operating system
+   *          support AVX2, sseLevel on other x86-64 processors and
+   *          scalarLevel otherwise. */
+  static SimdLevel detectLevel();
+
+private:
+  SimdLevel level;
+  /* The search image dilated by one pixel, with a one pixel border so every
+   * (row, col) from -1 to rows (cols) can be looked up, and one more row so
+   * a 4-byte gather of the last pixel stays inside the buffer: */
+  Mat dilated;
+};
@@ -0,0 +1,137 @@
+/* Description: A sparse representation of an edge-detected image. Stores the
+ * edge coordinates in the cells of a uniform grid (a spatial hash), so
+ * neighbour queries only look at the edges in nearby cells and the memory
+ * used scales with the number of edges instead of the resolution. */
+#include "sparseEdgeMap.h"
+
+/* Purpose: Constructor to create an empty map.
+ * Pre-conditions: None.
+ * Post-conditions: Creates a map with no edges. */
+SparseEdgeMap::SparseEdgeMap()
+    : rows(0), cols(0), cellSize(1), gridRows(0), gridCols(0), edges(0),
+      candidateStride(1), candidateCols(0) {}
+
+/* Purpose: To build the map from an edge-detected image.
+ * Pre-conditions: image is a single channel edge-detected image and cellSize
+ *          is at least 2.
+ * Post-conditions: Stores every edge of the image grouped by grid cell. */
+void SparseEdgeMap::build(const Mat &image, int edgeValue, int cellSize) {
+  rows = image.rows;
+  cols = image.cols;
+  this->cellSize = cellSize;
+  gridRows = (rows + cellSize - 1) / cellSize;
+  gridCols = (cols + cellSize - 1) / cellSize;
+
+  /* Empty the cells, keeping their memory for this image: */
+  if (cells.size() < static_cast<size_t>(gridRows * gridCols)) {
+    cells.resize(gridRows * gridCols);
+  }
+  for (vector<Point> &cell : cells) {
+    cell.clear();
+  }
+
+  /* Place each edge into its cell in a single scan of the image: */
+  edges = 0;
+  for (int row = 0; row < rows; ++row) {
+    const uchar *pixel = image.ptr<uchar>(row);
+    vector<Point> *cellRow = &cells[(row / cellSize) * gridCols];
+    for (int col = 0; col < cols; ++col) {
+      if (pixel[col] == edgeValue) {
+        cellRow[col / cellSize].push_back(Point(col, row));
+        edges++;
+      }
+    }
+  }
+}
+
+/* Purpose: To check the neighbors of a given (row, col) to see if edge.
+ * Pre-conditions: The map has been built.
+ * Post-conditions: Returns true if an edge is within one pixel of (row, col),
+ *          the same 3x3 neighbourhood as checkNeighbors. */
+bool SparseEdgeMap::hasNeighbor(int row, int col) const {
+  /* Check to see if the neighbourhood touches the image: */
+  if (row + 1 < 0 || row - 1 >= rows || col + 1 < 0 || col - 1 >= cols) {
+    return false;
+  }
+
+  /* Find the cells the 3x3 neighbourhood covers. Since cellSize is at least
+   * 2, that is at most 2x2 cells: */
+  int firstRow = max(row - 1, 0) / cellSize;
+  int lastRow = min(row + 1, rows - 1) / cellSize;
+  int firstCol = max(col - 1, 0) / cellSize;
+  int lastCol = min(col + 1, cols - 1) / cellSize;
+
+  for (int cellRow = firstRow; cellRow <= lastRow; ++cellRow) {
+    for (int cellCol = firstCol; cellCol <= lastCol; ++cellCol) {
+      for (const Point &point : cells[cellRow * gridCols + cellCol]) {
+        if (abs(point.y - row) <= 1 && abs(point.x - col) <= 1) {
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+/* Purpose: To mark which translations can reach an edge.
+ * Pre-conditions: The map has been built and stride is positive.
+ * Post-conditions: A translation on the stride grid is a candidate if an edge
+ *          lies within radius pixels of its grid cell. */
+void SparseEdgeMap::markCandidates(int stride, int radius) {
+  candidateStride = stride;
+  int candidateRows = (rows + stride - 1) / stride;
+  candidateCols = (cols + stride - 1) / stride;
+
+  /* Build a summed-area table of the translation cells that hold an edge: */
+  vector<int> &sums = candidateSums;
+  sums.assign((candidateRows + 1) * (candidateCols + 1), 0);
+  for (int cell = 0; cell < gridRows * gridCols; ++cell) {
+    for (const Point &point : cells[cell]) {
+      sums[(point.y / stride + 1) * (candidateCols + 1) + point.x / stride +
+           1] = 1;
+    }
+  }
+  for (int row = 1; row <= candidateRows; ++row) {
+    for (int col = 1; col <= candidateCols; ++col) {
+      sums[row * (candidateCols + 1) + col] +=
+          sums[(row - 1) * (candidateCols + 1) + col] +
+          sums[row * (candidateCols + 1) + col - 1] -
+          sums[(row - 1) * (candidateCols + 1) + col - 1];
+    }
+  }
+
+  /* A cell is a candidate if any cell within reach holds an edge: */
+  int reach = radius / stride + 1;
+  candidateCells.assign(candidateRows * candidateCols, false);
+  for (int row = 0; row < candidateRows; ++row) {
+    int top = max(row - reach, 0);
+    int bottom = min(row + reach, candidateRows - 1) + 1;
+    for (int col = 0; col < candidateCols; ++col) {
+      int left = max(col - reach, 0);
+      int right = min(col + reach, candidateCols - 1) + 1;
+      int total = sums[bottom * (candidateCols + 1) + right] -
+                  sums[top * (candidateCols + 1) + right] -
+                  sums[bottom * (candidateCols + 1) + left] +
+                  sums[top * (candidateCols + 1) + left];
+      candidateCells[row * candidateCols + col] = total > 0;
+    }
+  }
+}
+
+/* Purpose: To check if a translation can reach an edge.
+ * Pre-conditions: markCandidates has been called.
+ * Post-conditions: Returns false only if no edge is within radius pixels of
+ *          (row, col). */
+bool SparseEdgeMap::isCandidate(int row, int col) const {
+  if (row < 0 || row >= rows || col < 0 || col >= cols) {
+    return false;
+  }
+  return candidateCells[(row / candidateStride) * candidateCols +
+                        col / candidateStride];
+}
+
+/* Purpose: To get the number of edges in the map.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the number of edges. */
+int SparseEdgeMap::edgeCount() const { return edges; }
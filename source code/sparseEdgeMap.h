@@ -0,0 +1,72 @@
+/* Description: A sparse representation of an edge-detected image. Stores the
+ * edge coordinates in the cells of a uniform grid (a spatial hash), so
+ * neighbour queries only look at the edges in nearby cells and the memory
+ * used scales with the number of edges instead of the resolution. */
+#pragma once
+#include <opencv2/core.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+class SparseEdgeMap {
+public:
+  /* Purpose: Constructor to create an empty map.
+   * Pre-conditions: None.
+   * Post-conditions: Creates a map with no edges. */
+  SparseEdgeMap();
+
+  /* Purpose: To build the map from an edge-detected image.
+   * Pre-conditions: image is a single channel edge-detected image and
+   *          cellSize is at least 2.
+   * Post-conditions: Stores every edge of the image grouped by grid cell. */
+  void build(const Mat &image, int edgeValue, int cellSize);
+  /* Purpose: To check the neighbors of a given (row, col) to see if edge.
+   * Pre-conditions: The map has been built.
+   * Post-conditions: Returns true if an edge is within one pixel of
+   *          (row, col), the same 3x3 neighbourhood as checkNeighbors. */
+  bool hasNeighbor(int row, int col) const;
+
+  /* Purpose: To mark which translations can reach an edge.
+   * Pre-conditions: The map has been built and stride is positive.
+   * Post-conditions: A translation on the stride grid is a candidate if an
+   *          edge lies within radius pixels of its grid cell. */
+  void markCandidates(int stride, int radius);
+  /* Purpose: To check if a translation can reach an edge.
+   * Pre-conditions: markCandidates has been called.
+   * Post-conditions: Returns false only if no edge is within radius pixels
+   *          of (row, col). */
+  bool isCandidate(int row, int col) const;
+
+  /* Purpose: To get the number of edges in the map.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the number of edges. */
+  int edgeCount() const;
+
+private:
+  /* Dimensions of the image the map was built from: */
+  int rows;
+  int cols;
+
+  /* SPATIAL HASH VARIABLES */
+
+  /* Side of a grid cell in pixels and the number of cells per axis: */
+  int cellSize;
+  int gridRows;
+  int gridCols;
+  /* Edge coordinates of every cell, stored as (col, row). Kept between
+   * builds so the cells reuse their memory: */
+  vector<vector<Point>> cells;
+  /* Number of edges in the map: */
+  int edges;
+
+  /* CANDIDATE VARIABLES */
+
+  /* Stride of the translation grid and its number of columns: */
+  int candidateStride;
+  int candidateCols;
+  /* Summed-area table of the translation grid cells that hold an edge: */
+  vector<int> candidateSums;
+  /* True for every translation grid cell an edge can be reached from: */
+  vector<bool> candidateCells;
+};
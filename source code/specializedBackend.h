@@ -0,0 +1,221 @@
+/* Description: A scoring backend specialized at compile time. The
+ * neighbourhood radius is a template parameter, so the neighbour loops have
+ * fixed bounds, and the cos and sin of every rotation the transformation
+ * space uses come from constexpr tables. Points whose neighbourhood lies
+ * inside the image are checked without any bounds checks; only points near
+ * the image border take the checked path. */
+#pragma once
+#include "matcherBackend.h"
+
+/* The rotation tables cover every multiple of rotationStep degrees in a full
+ * turn, which includes every rotation of the default transformation space: */
+constexpr int rotationStep = 15;
+constexpr int rotationSteps = 360 / rotationStep;
+
+/* cos and sin of (step * rotationStep) * (pi / 180) with pi = 3.14159265,
+ * written out to the last bit so transformed points land exactly where the
+ * reference backend puts them: */
+constexpr double rotationCos[rotationSteps] = {
+    1,
+    0.96592582636649382,
+    0.86602540408358808,
+    0.70710678182113929,
+    0.50000000103628395,
+    0.25881904654730148,
+    1.7948965149208059e-09,
+    -0.25881904307982789,
+    -0.49999999792743216,
+    -0.70710677928277232,
+    -0.86602540228869163,
+    -0.96592582543738703,
+    -1,
+    -0.96592582729560061,
+    -0.86602540587848442,
+    -0.70710678435950602,
+    -0.50000000414513568,
+    -0.25881905001477507,
+    -5.3846893227178126e-09,
+    0.25881903961235408,
+    0.49999999481858021,
+    0.70710677674440536,
+    0.86602540049379506,
+    0.96592582450828024};
+constexpr double rotationSin[rotationSteps] = {
+    0,
+    0.25881904481356466,
+    0.49999999948185803,
+    0.70710678055195575,
+    0.86602540318613985,
+    0.96592582590194043,
+    1,
+    0.96592582683104722,
+    0.8660254049810362,
+    0.70710678309032271,
+    0.50000000259070987,
+    0.25881904828103836,
+    3.5897930298416118e-09,
+    -0.25881904134609079,
+    -0.49999999637300635,
+    -0.70710677801358901,
+    -0.8660254013912434,
+    -0.96592582497283375,
+    -1,
+    -0.96592582776015401,
+    -0.86602540677593276,
+    -0.70710678562868967,
+    -0.50000000569956182,
+    -0.25881905174851216};
+
+template <int Radius> class SpecializedBackend : public MatcherBackend {
+  static_assert(Radius >= 0, "The neighbourhood radius cannot be negative");
+
+public:
+  /* Purpose: Constructor to create an unprepared backend.
+   * Pre-conditions: None.
+   * Post-conditions: Creates a backend with no search image. */
+  SpecializedBackend();
+
+  string name() const override;
+  bool usesSparseMap() const override;
+  void prepare(const Mat &searchImage, int edgeValue,
+               const SparseEdgeMap *sparseMap) override;
+  int score(const vector<Point> &points, pair<double, double> scale,
+            int rotation, pair<int, int> origin) const override;
+
+private:
+  /* Purpose: To check the neighbors of a point well inside the image.
+   * Pre-conditions: (row, col) is at least Radius pixels from every border.
+   * Post-conditions: Returns true if an edge is within Radius pixels. */
+  bool interiorNeighbor(int row, int col) const;
+  /* Purpose: To check the neighbors of any point.
+   * Pre-conditions: None.
+   * Post-conditions: Returns true if an edge inside the image is within
+   *          Radius pixels. */
+  bool borderNeighbor(int row, int col) const;
+
+  const Mat *searchImage;
+  uchar edgeValue;
+  /* Number of rows and cols whose whole neighbourhood is inside the image: */
+  unsigned interiorRows;
+  unsigned interiorCols;
+};
+
+/* Purpose: Constructor to create an unprepared backend.
+ * Pre-conditions: None.
+ * Post-conditions: Creates a backend with no search image. */
+template <int Radius>
+SpecializedBackend<Radius>::SpecializedBackend()
+    : searchImage(nullptr), edgeValue(255), interiorRows(0),
+      interiorCols(0) {}
+
+/* Purpose: To get the name the backend is created with.
+ * Pre-conditions: None.
+ * Post-conditions: Returns "specialized", followed by the radius if it is
+ *          not the reference radius of 1. */
+template <int Radius> string SpecializedBackend<Radius>::name() const {
+  return Radius == 1 ? "specialized" : "specialized" + to_string(Radius);
+}
+
+/* Purpose: To get whether the backend answers from the spatial hash.
+ * Pre-conditions: None.
+ * Post-conditions: Returns false: the hash answers a one pixel neighbourhood
+ *          only, so the backend always reads the dense image. */
+template <int Radius> bool SpecializedBackend<Radius>::usesSparseMap() const {
+  return false;
+}
+
+/* Purpose: To prepare the backend for a search image.
+ * Pre-conditions: searchImage is an edge-detected image that outlives the
+ *          calls to score().
+ * Post-conditions: The backend can score transformations on the image. */
+template <int Radius>
+void SpecializedBackend<Radius>::prepare(
+    const Mat &searchImage, int edgeValue,
+    const SparseEdgeMap * /* sparseMap */) {
+  this->searchImage = &searchImage;
+  this->edgeValue = static_cast<uchar>(edgeValue);
+  interiorRows = static_cast<unsigned>(max(0, searchImage.rows - 2 * Radius));
+  interiorCols = static_cast<unsigned>(max(0, searchImage.cols - 2 * Radius));
+}
+
+/* Purpose: To count the edge matches of a transformed exemplar.
+ * Pre-conditions: prepare() has been called. points are (col, row).
+ * Post-conditions: With a Radius of 1, returns the same count as the
+ *          reference backend. */
+template <int Radius>
+int SpecializedBackend<Radius>::score(const vector<Point> &points,
+                                      pair<double, double> scale,
+                                      int rotation,
+                                      pair<int, int> origin) const {
+  int count = 0;
+
+  /* Look the rotation up in the tables, and only compute rotations outside
+   * them: */
+  double cosVal;
+  double sinVal;
+  if (rotation >= 0 && rotation < 360 && rotation % rotationStep == 0) {
+    cosVal = rotationCos[rotation / rotationStep];
+    sinVal = rotationSin[rotation / rotationStep];
+  } else {
+    const double pi = 3.14159265;
+    cosVal = cos(rotation * (pi / 180));
+    sinVal = sin(rotation * (pi / 180));
+  }
+
+  for (const Point &point : points) {
+    double newRow = ((sinVal * point.x) + (cosVal * point.y)) * scale.second +
+                    origin.first;
+    double newCol = ((cosVal * point.x) + (-sinVal * point.y)) * scale.first +
+                    origin.second;
+    int row = static_cast<int>(newRow);
+    int col = static_cast<int>(newCol);
+
+    /* One comparison per axis decides if the whole neighbourhood is inside
+     * the image: */
+    bool interior = static_cast<unsigned>(row - Radius) < interiorRows &&
+                    static_cast<unsigned>(col - Radius) < interiorCols;
+    if (interior ? interiorNeighbor(row, col) : borderNeighbor(row, col)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/* Purpose: To check the neighbors of a point well inside the image.
+ * Pre-conditions: (row, col) is at least Radius pixels from every border.
+ * Post-conditions: Returns true if an edge is within Radius pixels. */
+template <int Radius>
+bool SpecializedBackend<Radius>::interiorNeighbor(int row, int col) const {
+  for (int rowPlus = -Radius; rowPlus <= Radius; ++rowPlus) {
+    const uchar *taps = searchImage->ptr<uchar>(row + rowPlus) + col;
+    for (int colPlus = -Radius; colPlus <= Radius; ++colPlus) {
+      if (taps[colPlus] == edgeValue) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/* Purpose: To check the neighbors of any point.
+ * Pre-conditions: None.
+ * Post-conditions: Returns true if an edge inside the image is within Radius
+ *          pixels. */
+template <int Radius>
+bool SpecializedBackend<Radius>::borderNeighbor(int row, int col) const {
+  /* Clip the neighbourhood to the image once instead of checking every tap:
+   */
+  int firstRow = max(row - Radius, 0);
+  int lastRow = min(row + Radius, searchImage->rows - 1);
+  int firstCol = max(col - Radius, 0);
+  int lastCol = min(col + Radius, searchImage->cols - 1);
+  for (int changeRow = firstRow; changeRow <= lastRow; ++changeRow) {
+    const uchar *taps = searchImage->ptr<uchar>(changeRow);
+    for (int changeCol = firstCol; changeCol <= lastCol; ++changeCol) {
+      if (taps[changeCol] == edgeValue) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
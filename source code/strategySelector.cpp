@@ -0,0 +1,246 @@
+/* Description: A class that picks how match() searches translations from
+ * measured cost instead of a fixed edge density. A calibration run times both
+ * strategies on the exemplar and a sample of images and fits, per strategy, a
+ * linear model of time and probes on the image area and edge count. The two
+ * strategies can reach different verdicts, so calibration also compares
+ * their results; only if they agreed on every sample does each image use the
+ * strategy predicted to be cheapest. The prediction error is tracked. */
+#include "strategySelector.h"
+
+/* Purpose: Constructor to create an uncalibrated selector.
+ * Pre-conditions: None.
+ * Post-conditions: Creates a selector that leaves the choice to the density
+ *          rule until it is calibrated. */
+StrategySelector::StrategySelector()
+    : calibrated(false), disagreements(0), largestRatioDifference(0),
+      predictions(0), totalAbsoluteError(0) {
+  for (CostModel *model : {&translationModel, &gridModel}) {
+    for (int i = 0; i < 3; ++i) {
+      model->timeWeights[i] = 0;
+      model->probeWeights[i] = 0;
+    }
+  }
+}
+
+/* Purpose: To measure both strategies and fit their cost models.
+ * Pre-conditions: Each sample is an (edge-detected, original) pair of cropped
+ *          images.
+ * Post-conditions: Fits the time and probe models of both strategies and
+ *          compares their verdicts and ratios, without printing, saving or
+ *          caching the sample results. Leaves model as it was, even if
+ *          matching throws. Returns false if there were too few samples to
+ *          fit them. */
+bool StrategySelector::calibrate(ObjectRecognition &model,
+                                 vector<pair<Mat, Mat>> &samples) {
+  /* A model has 3 weights, so it needs at least 3 samples: */
+  if (samples.size() < 3) {
+    return false;
+  }
+
+  /* Structure that silences the console and detaches the writer, cache and
+   * budget of model for its lifetime, then gives them back, so model is
+   * restored however calibration ends: */
+  struct Detached {
+    ObjectRecognition &model;
+    ResultWriter *writer;
+    ResultCache *cache;
+    double budget;
+    TranslationStrategy forced;
+    ostringstream silenced;
+    streambuf *console;
+
+    Detached(ObjectRecognition &model)
+        : model(model), writer(model.getResultWriter()),
+          cache(model.getResultCache()), budget(model.getLatencyBudget()),
+          forced(model.getTranslationStrategy()) {
+      model.setResultWriter(nullptr);
+      model.setResultCache(nullptr);
+      model.setLatencyBudget(0);
+      console = cout.rdbuf(silenced.rdbuf());
+    }
+    ~Detached() {
+      cout.rdbuf(console);
+      model.setTranslationStrategy(forced);
+      model.setLatencyBudget(budget);
+      model.setResultCache(cache);
+      model.setResultWriter(writer);
+    }
+  };
+
+  /* Measure the full search alone: a cached or budgeted search would not
+   * show its cost, and the samples are not results worth saving or
+   * printing: */
+  Detached detached(model);
+  calibrated = false;
+  int rows = static_cast<int>(samples.size());
+  vector<MatchResult> translationResults;
+  disagreements = 0;
+  largestRatioDifference = 0;
+
+  for (TranslationStrategy strategy : {translationSearch, gridSearch}) {
+    Mat features(rows, 3, CV_64F);
+    Mat times(rows, 1, CV_64F);
+    Mat probes(rows, 1, CV_64F);
+
+    /* Time the strategy on every sample: */
+    model.setTranslationStrategy(strategy);
+    for (int i = 0; i < rows; ++i) {
+      Mat &edges = samples[i].first;
+      model.match(edges, samples[i].second, "calibration");
+      const MatchResult &result = model.getLastResult();
+
+      features.at<double>(i, 0) = 1;
+      features.at<double>(i, 1) =
+          static_cast<double>(edges.rows) * static_cast<double>(edges.cols);
+      features.at<double>(i, 2) = countNonZero(edges);
+      times.at<double>(i, 0) = result.elapsedMs;
+      probes.at<double>(i, 0) = static_cast<double>(result.probes);
+
+      /* Compare the verdict and ratio with the translation search on the
+       * same sample: */
+      if (strategy == translationSearch) {
+        translationResults.push_back(result);
+      } else {
+        const MatchResult &other = translationResults[i];
+        if (result.found != other.found) {
+          disagreements++;
+        }
+        largestRatioDifference = max(largestRatioDifference,
+                                     fabs(result.ratio - other.ratio));
+      }
+    }
+
+    fit(features, times, modelOf(strategy).timeWeights);
+    fit(features, probes, modelOf(strategy).probeWeights);
+  }
+
+  calibrated = true;
+  return true;
+}
+
+/* Purpose: To pick the cheapest strategy for an image.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the strategy with the lowest predicted time and
+ *          sets its predictions, or returns densityRule (leaving the
+ *          predictions alone) if the selector is not calibrated or the
+ *          strategies disagreed on a calibration sample. */
+TranslationStrategy StrategySelector::choose(double area, double edges,
+                                             double &predictedMs,
+                                             double &predictedProbes) const {
+  /* Choosing on time alone is only safe when both strategies give the same
+   * answers; otherwise keep the rule the tests were tuned with: */
+  if (!strategiesAgree()) {
+    return densityRule;
+  }
+
+  double translationMs =
+      predict(modelOf(translationSearch).timeWeights, area, edges);
+  double gridMs = predict(modelOf(gridSearch).timeWeights, area, edges);
+  TranslationStrategy strategy =
+      translationMs <= gridMs ? translationSearch : gridSearch;
+
+  predictedMs = min(translationMs, gridMs);
+  predictedProbes = predict(modelOf(strategy).probeWeights, area, edges);
+  return strategy;
+}
+
+/* Purpose: To track how far a prediction was from the measured time.
+ * Pre-conditions: None.
+ * Post-conditions: Adds the error to the running statistics. */
+void StrategySelector::recordError(double predictedMs, double actualMs) {
+  predictions++;
+  totalAbsoluteError += fabs(actualMs - predictedMs);
+}
+
+/* Purpose: To get whether both strategies reached the same verdict on every
+ *          calibration sample.
+ * Pre-conditions: None.
+ * Post-conditions: Returns true if calibrated and no sample was found by one
+ *          strategy but not the other. */
+bool StrategySelector::strategiesAgree() const {
+  return calibrated && disagreements == 0;
+}
+
+/* Purpose: To get how far apart the ratios of the strategies were.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the largest absolute difference between the
+ *          ratios of the two strategies on a calibration sample, or 0 before
+ *          calibration. */
+double StrategySelector::maxRatioDifference() const {
+  return largestRatioDifference;
+}
+
+/* Purpose: To get the prediction error of the images matched so far.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the mean absolute error in milliseconds, or 0
+ *          before any image. */
+double StrategySelector::meanAbsoluteError() const {
+  if (predictions == 0) {
+    return 0;
+  }
+  return totalAbsoluteError / predictions;
+}
+
+/* Purpose: To print the fitted models and prediction error.
+ * Pre-conditions: None.
+ * Post-conditions: Outputs the report to the window. */
+void StrategySelector::printReport() const {
+  cout << "****STRATEGY COST MODELS****" << endl;
+  if (!calibrated) {
+    cout << "Not calibrated; using the density rule." << endl;
+    return;
+  }
+  for (TranslationStrategy strategy : {translationSearch, gridSearch}) {
+    const CostModel &model = modelOf(strategy);
+    cout << (strategy == translationSearch ? "translation" : "grid")
+         << ": ms = " << model.timeWeights[0] << " + "
+         << model.timeWeights[1] << " * area + " << model.timeWeights[2]
+         << " * edges" << endl;
+  }
+  cout << "Verdicts differed on " << disagreements
+       << " calibration images; largest ratio difference "
+       << largestRatioDifference << endl;
+  if (!strategiesAgree()) {
+    cout << "Strategies disagree; using the density rule." << endl;
+  }
+  cout << "Mean absolute prediction error: " << meanAbsoluteError()
+       << " ms over " << predictions << " images" << endl;
+}
+
+/* Purpose: To fit a linear model by least squares.
+ * Pre-conditions: features has one row of (1, area, edges) per sample.
+ * Post-conditions: Sets the 3 weights that best predict values. */
+void StrategySelector::fit(const Mat &features, const Mat &values,
+                           double weights[]) const {
+  /* SVD gives the least-squares answer even when the samples do not vary
+   * enough to pin down every weight: */
+  Mat solution;
+  solve(features, values, solution, DECOMP_SVD);
+  for (int i = 0; i < 3; ++i) {
+    weights[i] = solution.at<double>(i, 0);
+  }
+}
+
+/* Purpose: To get the cost model of a strategy.
+ * Pre-conditions: strategy is translationSearch or gridSearch.
+ * Post-conditions: Returns the model of strategy. */
+StrategySelector::CostModel &
+StrategySelector::modelOf(TranslationStrategy strategy) {
+  return strategy == translationSearch ? translationModel : gridModel;
+}
+
+/* Purpose: To get the cost model of a strategy.
+ * Pre-conditions: strategy is translationSearch or gridSearch.
+ * Post-conditions: Returns the model of strategy. */
+const StrategySelector::CostModel &
+StrategySelector::modelOf(TranslationStrategy strategy) const {
+  return strategy == translationSearch ? translationModel : gridModel;
+}
+
+/* Purpose: To evaluate a linear model.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the prediction, never below 0. */
+double StrategySelector::predict(const double weights[], double area,
+                                 double edges) const {
+  return max(0.0, weights[0] + weights[1] * area + weights[2] * edges);
+}
@@ -0,0 +1,99 @@
+/* Description: A class that picks how match() searches translations from
+ * measured cost instead of a fixed edge density. A calibration run times both
+ * strategies on the exemplar and a sample of images and fits, per strategy, a
+ * linear model of time and probes on the image area and edge count. The two
+ * strategies can reach different verdicts, so calibration also compares
+ * their results; only if they agreed on every sample does each image use the
+ * strategy predicted to be cheapest. The prediction error is tracked. */
+#pragma once
+#include "objectRecognition.h"
+#include <sstream>
+
+class StrategySelector {
+public:
+  /* Purpose: Constructor to create an uncalibrated selector.
+   * Pre-conditions: None.
+   * Post-conditions: Creates a selector that leaves the choice to the
+   *          density rule until it is calibrated. */
+  StrategySelector();
+
+  /* Purpose: To measure both strategies and fit their cost models.
+   * Pre-conditions: Each sample is an (edge-detected, original) pair of
+   *          cropped images.
+   * Post-conditions: Fits the time and probe models of both strategies and
+   *          compares their verdicts and ratios, without printing, saving or
+   *          caching the sample results. Leaves model as it was, even if
+   *          matching throws. Returns false if there were too few samples to
+   *          fit them. */
+  bool calibrate(ObjectRecognition &model, vector<pair<Mat, Mat>> &samples);
+  /* Purpose: To pick the cheapest strategy for an image.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the strategy with the lowest predicted time and
+   *          sets its predictions, or returns densityRule (leaving the
+   *          predictions alone) if the selector is not calibrated or the
+   *          strategies disagreed on a calibration sample. */
+  TranslationStrategy choose(double area, double edges, double &predictedMs,
+                             double &predictedProbes) const;
+  /* Purpose: To track how far a prediction was from the measured time.
+   * Pre-conditions: None.
+   * Post-conditions: Adds the error to the running statistics. */
+  void recordError(double predictedMs, double actualMs);
+
+  /* Purpose: To get whether both strategies reached the same verdict on
+   *          every calibration sample.
+   * Pre-conditions: None.
+   * Post-conditions: Returns true if calibrated and no sample was found by
+   *          one strategy but not the other. */
+  bool strategiesAgree() const;
+  /* Purpose: To get how far apart the ratios of the strategies were.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the largest absolute difference between the
+   *          ratios of the two strategies on a calibration sample, or 0
+   *          before calibration. */
+  double maxRatioDifference() const;
+  /* Purpose: To get the prediction error of the images matched so far.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the mean absolute error in milliseconds, or 0
+   *          before any image. */
+  double meanAbsoluteError() const;
+  /* Purpose: To print the fitted models and prediction error.
+   * Pre-conditions: None.
+   * Post-conditions: Outputs the report to the window. */
+  void printReport() const;
+
+private:
+  /* Structure that stores the fitted cost of one strategy as
+   * weights[0] + weights[1] * area + weights[2] * edges: */
+  struct CostModel {
+    double timeWeights[3];
+    double probeWeights[3];
+  };
+
+  /* Purpose: To fit a linear model by least squares.
+   * Pre-conditions: features has one row of (1, area, edges) per sample.
+   * Post-conditions: Sets the 3 weights that best predict values. */
+  void fit(const Mat &features, const Mat &values, double weights[]) const;
+  /* Purpose: To get the cost model of a strategy.
+   * Pre-conditions: strategy is translationSearch or gridSearch.
+   * Post-conditions: Returns the model of strategy. */
+  CostModel &modelOf(TranslationStrategy strategy);
+  const CostModel &modelOf(TranslationStrategy strategy) const;
+  /* Purpose: To evaluate a linear model.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the prediction, never below 0. */
+  double predict(const double weights[], double area, double edges) const;
+
+  bool calibrated;
+  /* Cost models of each strategy: */
+  CostModel translationModel;
+  CostModel gridModel;
+
+  /* ACCURACY VARIABLES */
+  /* Calibration samples found by one strategy but not the other: */
+  int disagreements;
+  double largestRatioDifference;
+
+  /* PREDICTION ERROR VARIABLES */
+  int predictions;
+  double totalAbsoluteError;
+};
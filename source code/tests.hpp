@@ -6,6 +6,8 @@
  * Uses a variety of search images that have a variety of colors and features.
  */
 #include "helperFunctions.hpp"
+#include "resultCache.h"
+#include "strategySelector.h"
 #include <assert.h>
 #include <iostream>
 #include <opencv2/core.hpp>
@@ -34,8 +36,12 @@ void cottonMaskTestFVPos() {
 
   /* POSITIVE TESTING */
 
+  /* Save the outlined results in the background: */
+  ResultWriter writer;
+
   /* Create objectRecognition object for exemplar: */
   ObjectRecognition cottonMask(edgedEx);
+  cottonMask.setResultWriter(&writer);
 
   /* Create transformation space: */
   cottonMask.transformationSpace();
@@ -69,8 +75,12 @@ void cottonMaskTestFVNeg() {
   readImage(falseFV, "Person not wearing mask (front-view)");
   trimImage(falseFV, originalFalse);
 
+  /* Save the outlined results in the background: */
+  ResultWriter writer;
+
   /* Create objectRecognition object for exemplar: */
   ObjectRecognition cottonMask(exemplar);
+  cottonMask.setResultWriter(&writer);
 
   /* Create transformation space: */
   cottonMask.transformationSpace();
@@ -118,8 +128,12 @@ void cottonMaskFVIncorrectResults() {
   readImage(falsePos, "Person wearing mask (front-view)");
   trimImage(falsePos, originalPos);
 
+  /* Save the outlined results in the background: */
+  ResultWriter writer;
+
   /* Create objectRecognition object for exemplar: */
   ObjectRecognition cottonMask(edgedEx);
+  cottonMask.setResultWriter(&writer);
 
   /* Create transformation space: */
   cottonMask.transformationSpace();
@@ -156,4 +170,553 @@ void cottonMaskFVIncorrectResults() {
    * false even if true: */
   assert(!cottonMask.match(falseNeg, originalNeg, "falseNeg"));
   cout << endl;
-}
\ No newline at end of file
+}
+
+/* Purpose: To read in, edge-detect and crop the front-view mask exemplar.
+ * Pre-conditions: cottonMaskFV.jpg is in the working directory.
+ * Post-conditions: Sets edgedEx to the cropped edge image and originalEx to
+ *          the same crop of the original. */
+void frontViewExemplar(Mat &edgedEx, Mat &originalEx) {
+  bool loaded = loadExemplar("cottonMaskFV.jpg", edgedEx, originalEx);
+  assert(loaded);
+}
+
+/* Purpose: Sparse coarse probes on front-view cotton mask images.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskSparseProbeTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Create objectRecognition objects that probe the coarse levels with the
+   * sparse points (the default) and with every point: */
+  ObjectRecognition sparseMask(edgedEx);
+  sparseMask.transformationSpace();
+  SearchProfile denseProfile;
+  denseProfile.sparseLevels = 0;
+  ObjectRecognition denseMask(edgedEx, denseProfile);
+  denseMask.transformationSpace();
+
+  /* Probing with fewer points must not change the score or the box of any
+   * image: */
+  vector<LabelledImage> images = readLabelledImages(".", "labels.txt");
+  assert(!images.empty());
+  for (LabelledImage &image : images) {
+    bool sparse = sparseMask.match(image.edges, image.original,
+                                   image.name + "Sparse", &image.stats);
+    cout << endl;
+    bool dense = denseMask.match(image.edges, image.original,
+                                 image.name + "Dense", &image.stats);
+    cout << endl;
+    assert(sparse == dense);
+    assert(sparseMask.getLastResult().ratio == denseMask.getLastResult().ratio);
+    assert(sparseMask.getLastResult().box == denseMask.getLastResult().box);
+  }
+}
+
+/* Purpose: Orientation matching on front-view cotton mask with search images.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskOrientationTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Save the outlined results in the background: */
+  ResultWriter writer;
+
+  /* Create objectRecognition object for exemplar and score with gradient
+   * orientations: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.setResultWriter(&writer);
+  cottonMask.transformationSpace();
+  cottonMask.setOrientationMatching(originalEx);
+
+  /* Test positive image: */
+  assert(cottonMask.match(edgedEx, originalEx, "orientationTruePositive"));
+  cout << endl;
+
+  /* Read in negative search image: */
+  Mat originalFalse = imread("personWithNoMask.jpg");
+  Mat falseFV = originalFalse.clone();
+
+  /* Read in image and crop images: */
+  readImage(falseFV, "Person not wearing mask (front-view)");
+  trimImage(falseFV, originalFalse);
+
+  /* Test negative image: */
+  assert(!cottonMask.match(falseFV, originalFalse, "orientationTrueFalse"));
+  cout << endl;
+
+  /* FALSE POSITIVES */
+
+  /* Create objectRecognition object for exemplar that scores binary edge
+   * hits: */
+  ObjectRecognition edgeMask(edgedEx);
+  edgeMask.transformationSpace();
+
+  /* The false positives of cottonMaskFVIncorrectResults score lower once the
+   * orientation of every edge has to agree: */
+  for (string name : {"butterfly", "person1"}) {
+    Mat original = imread(name + ".jpg");
+    Mat edged = original.clone();
+    readImage(edged, name);
+    trimImage(edged, original);
+
+    edgeMask.match(edged, original, name + "Edges");
+    double edgeRatio = edgeMask.getLastResult().ratio;
+    cout << endl;
+    cottonMask.match(edged, original, name + "Orientation");
+    assert(cottonMask.getLastResult().ratio < edgeRatio);
+    cout << endl;
+  }
+}
+
+/* Purpose: Rejection cascade on front-view cotton mask with a search image.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskRejectionTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Save the outlined results in the background: */
+  ResultWriter writer;
+
+  /* Create objectRecognition object for exemplar: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.setResultWriter(&writer);
+  cottonMask.transformationSpace();
+
+  /* An edge density range the image is inside lets it through: */
+  RejectionCascade cascade;
+  cascade.minEdgeRatio = 0.01;
+  cottonMask.setRejectionCascade(cascade);
+  assert(cottonMask.match(edgedEx, originalEx, "cascadePassed"));
+  cout << endl;
+
+  /* An edge density range no image can be inside rejects the true positive
+   * before edge matching: */
+  cascade.minEdgeRatio = 1.0;
+  cottonMask.setRejectionCascade(cascade);
+  assert(!cottonMask.match(edgedEx, originalEx, "cascadeRejected"));
+}
+
+/* Purpose: Skipping of unreachable translations on front-view cotton mask
+ *          images.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskCandidatePruningTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Create objectRecognition object for exemplar that always searches the
+   * translation grid: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.transformationSpace();
+  cottonMask.setTranslationStrategy(gridSearch);
+
+  /* The translations pruning skips cannot reach an edge, so searching them
+   * as well must not change the result: */
+  for (string name : {"cottonMaskFV", "person1", "personWithNoMask"}) {
+    Mat original = imread(name + ".jpg");
+    Mat edged = original.clone();
+    readImage(edged, name);
+    trimImage(edged, original);
+
+    cottonMask.setCandidatePruning(true);
+    bool pruned = cottonMask.match(edged, original, name + "Pruned");
+    MatchResult prunedResult = cottonMask.getLastResult();
+    cout << endl;
+
+    cottonMask.setCandidatePruning(false);
+    assert(cottonMask.match(edged, original, name + "Unpruned") == pruned);
+    assert(cottonMask.getLastResult().ratio == prunedResult.ratio);
+    assert(cottonMask.getLastResult().probes >= prunedResult.probes);
+    cout << endl;
+  }
+}
+
+/* Purpose: Validation of the search profile.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void searchProfileValidationTest() {
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Bucket sizes other than 4, strides that never advance, a negative
+   * sparse margin and profiles that leave no scale or rotation to search are
+   * rejected: */
+  SearchProfile profiles[6];
+  profiles[0].bucketSize = 3;
+  profiles[1].bucketSize = 8;
+  profiles[2].gridStride = 0;
+  profiles[3].sparseMargin = -1;
+  profiles[4].maxPixelValue = edgedEx.rows / 2;
+  profiles[5].maxRotation = profiles[5].incrementRotation / 4;
+  for (const SearchProfile &profile : profiles) {
+    bool rejected = false;
+    try {
+      ObjectRecognition cottonMask(edgedEx, profile);
+    } catch (const invalid_argument &) {
+      rejected = true;
+    }
+    assert(rejected);
+  }
+
+  /* The default profile is accepted: */
+  ObjectRecognition cottonMask(edgedEx, SearchProfile());
+}
+
+/* Purpose: Latency budget on front-view cotton mask with a search image.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskLatencyBudgetTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Save the outlined results in the background: */
+  ResultWriter writer;
+
+  /* Create objectRecognition object for exemplar: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.setResultWriter(&writer);
+  cottonMask.transformationSpace();
+
+  /* Without a budget the search always completes: */
+  assert(cottonMask.match(edgedEx, originalEx, "budgetUnlimited"));
+  assert(cottonMask.getLastResult().completed);
+  cout << endl;
+
+  /* A budget far below the cost of one probe stops the search early: */
+  cottonMask.setLatencyBudget(0.000001);
+  cottonMask.match(edgedEx, originalEx, "budgetExceeded");
+  assert(!cottonMask.getLastResult().completed);
+}
+
+/* Purpose: Reuse of one object for a match and then a blank image.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskReuseTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Create objectRecognition object for exemplar: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.transformationSpace();
+
+  /* The true positive leaves a box behind: */
+  assert(cottonMask.match(edgedEx, originalEx, "reusePositive"));
+  assert(!cottonMask.getLastResult().box.empty());
+  cout << endl;
+
+  /* A blank image has no edges to probe, so it must not report the box of
+   * the previous match: */
+  Mat blank = Mat::zeros(edgedEx.size(), edgedEx.type());
+  Mat blankOriginal = Mat::zeros(originalEx.size(), originalEx.type());
+  assert(!cottonMask.match(blank, blankOriginal, "reuseBlank"));
+  assert(cottonMask.getLastResult().box.empty());
+}
+
+/* Purpose: Sampling of the background result writer.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void resultWriterSamplingTest() {
+  /* Read in an image to outline: */
+  Mat original = imread("cottonMaskFV.jpg");
+  Rect box(0, 0, original.cols / 2, original.rows / 2);
+
+  /* Only keep positives: */
+  WriterOptions options;
+  options.positivesOnly = true;
+  ResultWriter writer(options);
+
+  /* A negative is sampled out, a positive is saved: */
+  assert(!writer.submit(original, box, false, "writerNegative"));
+  assert(writer.submit(original, box, true, "writerPositive"));
+  writer.flush();
+  assert(writer.getWritten() == 1);
+  assert(writer.getDropped() == 0);
+}
+
+/* Purpose: Multi-detection on front-view cotton mask with a search image.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskMultiDetectionTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Create objectRecognition object for exemplar and keep every
+   * detection: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.transformationSpace();
+  cottonMask.setMultiDetection(true, 0.3);
+
+  /* Test positive image: */
+  assert(cottonMask.match(edgedEx, originalEx, "multiDetection"));
+  const vector<Detection> &detections = cottonMask.getDetections();
+
+  /* The best detection is the single best match: */
+  assert(!detections.empty());
+  assert(detections[0].score == cottonMask.getLastResult().ratio);
+
+  /* Detections are ranked and no two overlap more than allowed: */
+  for (size_t i = 0; i < detections.size(); ++i) {
+    cout << "Detection " << i << ": " << detections[i].score * 100 << "% at ("
+         << detections[i].origin.first << ", " << detections[i].origin.second
+         << ")" << endl;
+    for (size_t j = i + 1; j < detections.size(); ++j) {
+      assert(detections[i].score >= detections[j].score);
+      double overlap = (detections[i].box & detections[j].box).area();
+      double total =
+          detections[i].box.area() + detections[j].box.area() - overlap;
+      assert(total <= 0 || overlap / total <= 0.3);
+    }
+  }
+}
+
+/* Purpose: Result cache on front-view cotton mask with repeated frames.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskResultCacheTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Create objectRecognition object for exemplar with a result cache: */
+  ResultCache cache(4, 0);
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.transformationSpace();
+  cottonMask.setResultCache(&cache);
+
+  /* The first frame is searched: */
+  assert(cottonMask.match(edgedEx, originalEx, "cacheMiss"));
+  MatchResult searched = cottonMask.getLastResult();
+  assert(!searched.cached);
+  cout << endl;
+
+  /* The repeated frame gets the same verdict and box without a search: */
+  assert(cottonMask.match(edgedEx, originalEx, "cacheHit"));
+  assert(cottonMask.getLastResult().cached);
+  assert(cottonMask.getLastResult().probes == 0);
+  assert(cottonMask.getLastResult().ratio == searched.ratio);
+  assert(cottonMask.getLastResult().box == searched.box);
+  assert(cache.getHits() == 1 && cache.getMisses() == 1);
+  assert(cache.hitRate() == 0.5);
+  cout << endl;
+
+  /* With multi-detection, a repeated frame gets the same detections: */
+  ResultCache multiCache(4, 0);
+  ObjectRecognition multiMask(edgedEx);
+  multiMask.transformationSpace();
+  multiMask.setMultiDetection(true, 0.3);
+  multiMask.setResultCache(&multiCache);
+  assert(multiMask.match(edgedEx, originalEx, "multiCacheMiss"));
+  vector<Detection> detections = multiMask.getDetections();
+  assert(!detections.empty());
+  cout << endl;
+  assert(multiMask.match(edgedEx, originalEx, "multiCacheHit"));
+  assert(multiMask.getLastResult().cached);
+  assert(multiMask.getDetections().size() == detections.size());
+  assert(multiMask.getDetections()[0].box == detections[0].box);
+
+  /* With a tolerance of 0, only an exact repeat is the same frame: */
+  EdgeFingerprint print = cache.fingerprint(edgedEx);
+  MatchResult result;
+  vector<Detection> cachedDetections;
+  EdgeFingerprint trimmed = print;
+  trimmed.rows += 2;
+  assert(!cache.lookup(trimmed, result, cachedDetections));
+  trimmed.rows = print.rows;
+  trimmed.exact++;
+  assert(!cache.lookup(trimmed, result, cachedDetections));
+
+  /* With a tolerance, a frame trimmed a few pixels differently is the same
+   * frame, with its box stretched to the new size, and one of a clearly
+   * different size is not: */
+  ResultCache nearCache(4, 8, 4);
+  nearCache.insert(print, searched, vector<Detection>());
+  trimmed = print;
+  trimmed.cols += 4;
+  assert(nearCache.lookup(trimmed, result, cachedDetections));
+  assert(result.box.y == searched.box.y);
+  assert(result.box.height == searched.box.height);
+  assert(result.box.width >= searched.box.width);
+  trimmed.cols += 40;
+  assert(!nearCache.lookup(trimmed, result, cachedDetections));
+}
+
+/* Purpose: Strategy selection on front-view cotton mask images.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskStrategySelectorTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Read in and crop the calibration images: */
+  vector<pair<Mat, Mat>> samples;
+  for (string name : {"cottonMaskFV", "person1", "personWithNoMask",
+                      "personWithNoMask2"}) {
+    Mat original = imread(name + ".jpg");
+    Mat edged = original.clone();
+    readImage(edged, name);
+    trimImage(edged, original);
+    samples.push_back(make_pair(edged, original));
+  }
+
+  /* Create objectRecognition object for exemplar: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.transformationSpace();
+
+  /* A forced strategy is the one searched with, whatever the density: */
+  cottonMask.setTranslationStrategy(gridSearch);
+  assert(cottonMask.match(edgedEx, originalEx, "forcedGrid"));
+  assert(cottonMask.getLastResult().strategy == gridSearch);
+  assert(cottonMask.getLastResult().predictedMs < 0);
+  cottonMask.setTranslationStrategy(densityRule);
+  cout << endl;
+
+  /* Calibration measures full searches and leaves the writer, cache and
+   * budget of the object as they were, with none of its results in them: */
+  ResultWriter writer;
+  ResultCache cache;
+  cottonMask.setResultWriter(&writer);
+  cottonMask.setResultCache(&cache);
+  cottonMask.setLatencyBudget(1000);
+  StrategySelector selector;
+  assert(selector.calibrate(cottonMask, samples));
+  assert(cottonMask.getResultWriter() == &writer);
+  assert(cottonMask.getResultCache() == &cache);
+  assert(cottonMask.getLatencyBudget() == 1000);
+  assert(cottonMask.getTranslationStrategy() == densityRule);
+  writer.flush();
+  assert(writer.getWritten() == 0);
+  assert(cache.getHits() + cache.getMisses() == 0);
+  cottonMask.setResultCache(nullptr);
+  cottonMask.setLatencyBudget(0);
+
+  /* The calibrated selector predicts the cost of every search, unless the
+   * strategies reached different verdicts during calibration: */
+  cottonMask.setStrategySelector(&selector);
+  assert(selector.maxRatioDifference() >= 0);
+  assert(cottonMask.match(edgedEx, originalEx, "selected"));
+  assert(cottonMask.getLastResult().strategy != densityRule);
+  if (selector.strategiesAgree()) {
+    assert(cottonMask.getLastResult().predictedMs >= 0);
+    assert(cottonMask.getLastResult().predictedProbes >= 0);
+  } else {
+    assert(cottonMask.getLastResult().predictedMs < 0);
+  }
+  selector.printReport();
+}
+
+/* Purpose: Matcher backends on front-view cotton mask images.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void cottonMaskMatcherBackendTestFV() {
+  /* EXEMPLAR */
+
+  Mat edgedEx;
+  Mat originalEx;
+  frontViewExemplar(edgedEx, originalEx);
+
+  /* Read in negative search image: */
+  Mat originalFalse = imread("personWithNoMask.jpg");
+  Mat falseFV = originalFalse.clone();
+
+  /* Read in image and crop images: */
+  readImage(falseFV, "Person not wearing mask (front-view)");
+  trimImage(falseFV, originalFalse);
+
+  /* Create objectRecognition objects with the reference backend and with
+   * every other backend: */
+  ObjectRecognition reference(edgedEx);
+  reference.transformationSpace();
+  assert(reference.getMatcherBackend() == "reference");
+  assert(!reference.setMatcherBackend("unknown"));
+  assert(reference.getMatcherBackend() == "reference");
+
+  for (const string &name : matcherBackendNames()) {
+    ObjectRecognition cottonMask(edgedEx);
+    cottonMask.transformationSpace();
+    assert(cottonMask.setMatcherBackend(name));
+
+    /* Every backend gets the same scores as the reference: */
+    assert(cottonMask.match(edgedEx, originalEx, name + "Positive"));
+    assert(reference.match(edgedEx, originalEx, "referencePositive"));
+    assert(cottonMask.getLastResult().ratio == reference.getLastResult().ratio);
+    assert(cottonMask.getLastResult().box == reference.getLastResult().box);
+    cout << endl;
+
+    assert(!cottonMask.match(falseFV, originalFalse, name + "Negative"));
+    assert(!reference.match(falseFV, originalFalse, "referenceNegative"));
+    assert(cottonMask.getLastResult().ratio == reference.getLastResult().ratio);
+    cout << endl;
+  }
+}
+
+/* Purpose: Fused preprocessing pass on a small image and the cotton mask.
+ * Pre-conditions: None.
+ * Post-conditions: Passes the tests successfully. */
+void edgeStatsTest() {
+  /* Edges at (1, 2), (2, 4), (3, 2) and (4, 5) of a 6 x 7 image: */
+  Mat small(6, 7, CV_8UC1, Scalar(0));
+  small.at<uchar>(1, 2) = edge;
+  small.at<uchar>(2, 4) = edge;
+  small.at<uchar>(3, 2) = edge;
+  small.at<uchar>(4, 5) = edge;
+  Mat smallOriginal = small.clone();
+
+  /* The crop leaves out the last edge row and col, so (4, 5) is not
+   * counted: */
+  EdgeStats stats = trimImage(small, smallOriginal);
+  assert(stats.crop == Rect(2, 1, 3, 3));
+  assert(small.rows == 3 && small.cols == 3);
+  assert(stats.edges == 3);
+  assert(stats.density == 3 / 9.0);
+  assert(stats.rowEdges == vector<int>({1, 1, 1}));
+  assert(stats.colEdges == vector<int>({2, 0, 1}));
+
+  /* EXEMPLAR */
+
+  /* Trim the front-view mask exemplar, keeping the statistics of the pass:
+   */
+  Mat originalEx = imread("cottonMaskFV.jpg");
+  Mat edgedEx = originalEx.clone();
+  readImage(edgedEx, "Exemplar Image (front-view)");
+  stats = trimImage(edgedEx, originalEx);
+  assert(stats.edges == countNonZero(edgedEx == edge));
+
+  /* Matching with the statistics of the pass gives the same result: */
+  ObjectRecognition cottonMask(edgedEx);
+  cottonMask.transformationSpace();
+  assert(cottonMask.match(edgedEx, originalEx, "withoutStats"));
+  double ratio = cottonMask.getLastResult().ratio;
+  assert(cottonMask.match(edgedEx, originalEx, "withStats", &stats));
+  assert(cottonMask.getLastResult().ratio == ratio);
+}
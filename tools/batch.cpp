@@ -0,0 +1,105 @@
+/* Description: Batch mode for matching large sets of archived images on
+ * several processes or machines. A coordinator splits a manifest into shards
+ * and workers, each keeping one prepared model loaded, match the shards and
+ * send back the results, which the coordinator merges into one file. A shard
+ * of a worker that dies is retried by another worker.
+ *
+ * Usage: batch coordinator [port] [manifest] [output] [shard size]
+ *        batch worker [host] [port] [exemplar] [backend] [fail after]
+ * The manifest has one image path per line; a labels file also works, as
+ * only the first field of a line is used. Paths are opened by the workers.
+ * A worker given "fail after" drops out after that many images, to test
+ * retries. */
+#include "shardCoordinator.h"
+#include "shardWorker.h"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+/* Purpose: To read the image paths of a manifest.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the first field of every line that is not empty
+ *          or a "#" comment. */
+vector<string> readManifest(const string &manifestFile) {
+  vector<string> images;
+  ifstream manifest(manifestFile);
+  string line;
+  while (getline(manifest, line)) {
+    istringstream fields(line);
+    string image;
+    if (fields >> image && image[0] != '#') {
+      images.push_back(image);
+    }
+  }
+  return images;
+}
+
+/* Purpose: To run the coordinator.
+ * Pre-conditions: None.
+ * Post-conditions: Returns 0 if every image got a result. */
+int runCoordinator(int argc, char *argv[]) {
+  int port = argc > 2 ? atoi(argv[2]) : 5757;
+  string manifestFile = argc > 3 ? argv[3] : "labels.txt";
+  string outputFile = argc > 4 ? argv[4] : "batchResults.tsv";
+  int shardSize = argc > 5 ? atoi(argv[5]) : 16;
+
+  vector<string> images = readManifest(manifestFile);
+  if (images.empty()) {
+    cout << "No images in " + manifestFile << endl;
+    return 1;
+  }
+  if (shardSize <= 0 || shardSize > ShardWorker::maxShardImages) {
+    cout << "Shard size must be 1 to " << ShardWorker::maxShardImages << endl;
+    return 1;
+  }
+
+  ShardCoordinator coordinator(images, shardSize);
+  bool completed = coordinator.run(port, outputFile);
+  coordinator.printThroughput();
+  return completed ? 0 : 1;
+}
+
+/* Purpose: To run a worker.
+ * Pre-conditions: None.
+ * Post-conditions: Returns 0 if the worker stayed until the batch was done. */
+int runWorker(int argc, char *argv[]) {
+  string host = argc > 2 ? argv[2] : "localhost";
+  int port = argc > 3 ? atoi(argv[3]) : 5757;
+  string exemplarFile = argc > 4 ? argv[4] : "cottonMaskFV.jpg";
+  string backend = argc > 5 ? argv[5] : "reference";
+  int failAfter = argc > 6 ? atoi(argv[6]) : -1;
+
+  /* Name the worker by host and process, so several on one host differ: */
+  char hostName[256] = "worker";
+  gethostname(hostName, sizeof(hostName) - 1);
+  string name = string(hostName) + "-" + to_string(getpid());
+
+  /* Prepare the model once for every shard: */
+  ShardWorker worker(name);
+  if (!worker.prepare(exemplarFile, backend)) {
+    return 1;
+  }
+  bool completed = worker.run(host, port, failAfter);
+  cout << "Worker " << name << " matched " << worker.getImages() << " images"
+       << endl;
+  return completed ? 0 : 1;
+}
+
+/* Purpose: Run the coordinator or a worker.
+ * Pre-conditions: None.
+ * Post-conditions: Returns 0 on success. */
+int main(int argc, char *argv[]) {
+  string mode = argc > 1 ? argv[1] : "";
+  if (mode == "coordinator") {
+    return runCoordinator(argc, argv);
+  }
+  if (mode == "worker") {
+    return runWorker(argc, argv);
+  }
+  cout << "Usage: batch coordinator [port] [manifest] [output] [shard size]"
+       << endl;
+  cout << "       batch worker [host] [port] [exemplar] [backend] "
+          "[fail after]"
+       << endl;
+  return 1;
+}
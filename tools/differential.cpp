@@ -0,0 +1,245 @@
+/* Description: Runs two matcher backends side by side and reports how their
+ * scores differ and how much faster one is. First every probe of a set of
+ * random synthetic edge maps is scored by both backends, once on the dense
+ * image and once with its spatial hash as the grid search hands it over,
+ * then both run the whole search on a labelled image set. A backend is safe
+ * to turn on when every part reports no differences.
+ *
+ * Usage: differential [backend A] [backend B] [exemplar] [image directory]
+ *                     [labels file]
+ * Backend A defaults to "reference" and backend B to "dilated". */
+#include "helperFunctions.hpp"
+#include <chrono>
+#include <random>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+/* Structure that stores how two backends compared: */
+struct Difference {
+  long long comparisons = 0;
+  long long mismatches = 0;
+  double maxDifference = 0;
+  double msA = 0;
+  double msB = 0;
+};
+
+/* Purpose: To create a random edge map.
+ * Pre-conditions: density is between 0 and 1.
+ * Post-conditions: Returns a rows x cols image where each pixel is an edge
+ *          with probability density. */
+Mat randomEdgeMap(int rows, int cols, double density, mt19937 &random) {
+  uniform_real_distribution<double> chance(0, 1);
+  Mat image(rows, cols, CV_8UC1);
+  for (int row = 0; row < rows; ++row) {
+    uchar *pixels = image.ptr<uchar>(row);
+    for (int col = 0; col < cols; ++col) {
+      pixels[col] = chance(random) < density ? edge : 0;
+    }
+  }
+  return image;
+}
+
+/* Purpose: To score random probes of synthetic edge maps with both backends.
+ * Pre-conditions: a and b are valid backends.
+ * Post-conditions: Returns the differences and time of every probe. With
+ *          sparse, both backends are prepared with the spatial hash of each
+ *          edge map, as the grid search prepares them. */
+Difference compareSynthetic(MatcherBackend &a, MatcherBackend &b,
+                            bool sparse) {
+  Difference difference;
+  mt19937 random(2020);
+  SearchProfile profile;
+  SparseEdgeMap sparseMap;
+
+  for (double density : {0.01, 0.05, 0.20}) {
+    for (int trial = 0; trial < 4; ++trial) {
+      uniform_int_distribution<int> side(60, 400);
+      Mat search = randomEdgeMap(side(random), side(random), density, random);
+      Mat exemplar = randomEdgeMap(side(random) / 4, side(random) / 4, 0.1,
+                                   random);
+
+      /* Hash the edges with the cell size ObjectRecognition uses: */
+      const SparseEdgeMap *hash = nullptr;
+      if (sparse) {
+        sparseMap.build(search, edge, 8);
+        hash = &sparseMap;
+      }
+
+      /* Score the exemplar points as ObjectRecognition does: */
+      vector<Point> points;
+      for (int row = 0; row < exemplar.rows; ++row) {
+        for (int col = 0; col < exemplar.cols; ++col) {
+          if (exemplar.at<uchar>(row, col) == edge) {
+            points.push_back(Point(col, row));
+          }
+        }
+      }
+
+      /* Random probes from the default transformation space, with origins
+       * that also reach past the image border: */
+      uniform_int_distribution<int> steps(
+          0, static_cast<int>(profile.maxScale / profile.incrementScale));
+      uniform_int_distribution<int> turns(
+          0, profile.maxRotation / profile.incrementRotation);
+      uniform_int_distribution<int> originRow(-exemplar.rows, search.rows);
+      uniform_int_distribution<int> originCol(-exemplar.cols, search.cols);
+      vector<pair<double, double>> scales;
+      vector<int> rotations;
+      vector<pair<int, int>> origins;
+      for (int probe = 0; probe < 2000; ++probe) {
+        scales.push_back(
+            make_pair(max(profile.minScale, steps(random) *
+                                                profile.incrementScale),
+                      max(profile.minScale,
+                          steps(random) * profile.incrementScale)));
+        rotations.push_back(turns(random) * profile.incrementRotation);
+        origins.push_back(make_pair(originRow(random), originCol(random)));
+      }
+
+      /* Score every probe with each backend, timing them separately: */
+      vector<int> scoresA(origins.size());
+      vector<int> scoresB(origins.size());
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      a.prepare(search, edge, hash);
+      for (size_t probe = 0; probe < origins.size(); ++probe) {
+        scoresA[probe] =
+            a.score(points, scales[probe], rotations[probe], origins[probe]);
+      }
+      chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+      b.prepare(search, edge, hash);
+      for (size_t probe = 0; probe < origins.size(); ++probe) {
+        scoresB[probe] =
+            b.score(points, scales[probe], rotations[probe], origins[probe]);
+      }
+      chrono::steady_clock::time_point end = chrono::steady_clock::now();
+      difference.msA += chrono::duration<double, milli>(middle - start).count();
+      difference.msB += chrono::duration<double, milli>(end - middle).count();
+
+      for (size_t probe = 0; probe < origins.size(); ++probe) {
+        double apart = abs(scoresA[probe] - scoresB[probe]) /
+                       static_cast<double>(max<size_t>(points.size(), 1));
+        difference.comparisons++;
+        if (apart > 0) {
+          difference.mismatches++;
+        }
+        difference.maxDifference = max(apart, difference.maxDifference);
+      }
+    }
+  }
+  return difference;
+}
+
+/* Purpose: To run the whole search on labelled images with both backends.
+ * Pre-conditions: edgedEx is the cropped edge-detected exemplar.
+ * Post-conditions: Prints one row per image and returns the differences in
+ *          match ratio and the time of every search. */
+Difference compareImages(const Mat &edgedEx, const string &nameA,
+                         const string &nameB,
+                         vector<LabelledImage> &images) {
+  Difference difference;
+  ObjectRecognition modelA(edgedEx);
+  ObjectRecognition modelB(edgedEx);
+  modelA.setMatcherBackend(nameA);
+  modelB.setMatcherBackend(nameB);
+  modelA.transformationSpace();
+  modelB.transformationSpace();
+
+  cout << "image | ratio A ratio B | ms A ms B" << endl;
+  for (LabelledImage &image : images) {
+    /* Silence the per-image results while measuring: */
+    ostringstream silenced;
+    streambuf *console = cout.rdbuf(silenced.rdbuf());
+    modelA.match(image.edges, image.original, image.name, &image.stats);
+    modelB.match(image.edges, image.original, image.name, &image.stats);
+    cout.rdbuf(console);
+
+    const MatchResult &resultA = modelA.getLastResult();
+    const MatchResult &resultB = modelB.getLastResult();
+    double apart = fabs(resultA.ratio - resultB.ratio);
+    difference.comparisons++;
+    if (apart > 0 || resultA.found != resultB.found ||
+        !(resultA.box == resultB.box)) {
+      difference.mismatches++;
+    }
+    difference.maxDifference = max(apart, difference.maxDifference);
+    difference.msA += resultA.elapsedMs;
+    difference.msB += resultB.elapsedMs;
+
+    cout << image.name << " | " << resultA.ratio << " " << resultB.ratio
+         << " | " << resultA.elapsedMs << " " << resultB.elapsedMs << endl;
+  }
+  return difference;
+}
+
+/* Purpose: To print how two backends compared.
+ * Pre-conditions: None.
+ * Post-conditions: Outputs the differences and speedup to the window. */
+void printDifference(const string &title, const Difference &difference) {
+  cout << title << ": " << difference.mismatches << " of "
+       << difference.comparisons << " differ, largest difference "
+       << difference.maxDifference << ", " << difference.msA << " ms vs "
+       << difference.msB << " ms";
+  if (difference.msB > 0) {
+    cout << " (speedup " << difference.msA / difference.msB << "x)";
+  }
+  cout << endl;
+}
+
+/* Purpose: Compare two backends and print the results.
+ * Pre-conditions: The exemplar and labelled images can be read.
+ * Post-conditions: Returns 0 if the backends agree everywhere, 2 if they
+ *          differ and 1 if the inputs are invalid. */
+int main(int argc, char *argv[]) {
+  string nameA = argc > 1 ? argv[1] : "reference";
+  string nameB = argc > 2 ? argv[2] : "dilated";
+  string exemplarFile = argc > 3 ? argv[3] : "cottonMaskFV.jpg";
+  string directory = argc > 4 ? argv[4] : ".";
+  string labelsFile = argc > 5 ? argv[5] : directory + "/labels.txt";
+
+  MatcherBackend *a = createMatcherBackend(nameA);
+  MatcherBackend *b = createMatcherBackend(nameB);
+  if (a == nullptr || b == nullptr) {
+    cout << "Backends are:";
+    for (const string &name : matcherBackendNames()) {
+      cout << " " << name;
+    }
+    cout << endl;
+    delete a;
+    delete b;
+    return 1;
+  }
+
+  /* Compare every probe on synthetic edge maps, on the dense images and
+   * through their spatial hashes: */
+  cout << fixed << setprecision(4);
+  Difference synthetic = compareSynthetic(*a, *b, false);
+  Difference hashed = compareSynthetic(*a, *b, true);
+  delete a;
+  delete b;
+  printDifference("Synthetic probes", synthetic);
+  printDifference("Synthetic probes with spatial hash", hashed);
+
+  /* Read in, edge-detect and crop the exemplar: */
+  Mat edgedEx;
+  Mat originalEx;
+  if (!loadExemplar(exemplarFile, edgedEx, originalEx)) {
+    return 1;
+  }
+
+  vector<LabelledImage> images = readLabelledImages(directory, labelsFile);
+  if (images.empty()) {
+    cout << "No labelled images in " + labelsFile << endl;
+    return 1;
+  }
+
+  /* Compare the whole search on the labelled images: */
+  Difference searched = compareImages(edgedEx, nameA, nameB, images);
+  printDifference("Labelled images", searched);
+
+  return synthetic.mismatches == 0 && hashed.mismatches == 0 &&
+                 searched.mismatches == 0
+             ? 0
+             : 2;
+}
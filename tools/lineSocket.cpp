@@ -0,0 +1,179 @@
+/* Description: A TCP connection that sends and receives text one line at a
+ * time, used by the batch coordinator and its workers. Built on POSIX
+ * sockets. */
+#include "lineSocket.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* A lost connection must show up as a failed send, not kill the process with
+ * SIGPIPE: */
+#ifdef MSG_NOSIGNAL
+const int sendFlags = MSG_NOSIGNAL;
+#else
+const int sendFlags = 0;
+#endif
+
+/* Purpose: Constructor to take over an open socket.
+ * Pre-conditions: descriptor is a connected socket, or -1.
+ * Post-conditions: The object closes the socket when it is destroyed. */
+LineSocket::LineSocket(int descriptor) : descriptor(descriptor) {}
+
+/* Purpose: Destructor to close the socket.
+ * Pre-conditions: None.
+ * Post-conditions: Closes the socket if it is open. */
+LineSocket::~LineSocket() { close(); }
+
+/* Purpose: To open a socket that accepts connections.
+ * Pre-conditions: None.
+ * Post-conditions: Returns a socket listening on port of every interface, or
+ *          -1 if the port cannot be used. */
+int LineSocket::listenOn(int port) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return -1;
+  }
+
+  /* Let a restarted coordinator reuse the port straight away: */
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listener, 64) < 0) {
+    ::close(listener);
+    return -1;
+  }
+  return listener;
+}
+
+/* Purpose: To connect to a listening socket.
+ * Pre-conditions: None.
+ * Post-conditions: Returns a socket connected to host:port, or -1. */
+int LineSocket::connectTo(const string &host, int port) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *found = nullptr;
+  if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &found) !=
+      0) {
+    return -1;
+  }
+
+  /* Try every address of the host until one connects: */
+  int connection = -1;
+  for (addrinfo *it = found; it != nullptr; it = it->ai_next) {
+    connection = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+    if (connection < 0) {
+      continue;
+    }
+    if (connect(connection, it->ai_addr, it->ai_addrlen) == 0) {
+      break;
+    }
+    ::close(connection);
+    connection = -1;
+  }
+  freeaddrinfo(found);
+  return connection;
+}
+
+/* Purpose: To bound how long a send may wait for the peer to read.
+ * Pre-conditions: seconds is positive.
+ * Post-conditions: A send that cannot go on for seconds fails. Returns false
+ *          if the timeout cannot be set. */
+bool LineSocket::setSendTimeout(double seconds) {
+  timeval timeout = {};
+  timeout.tv_sec = static_cast<time_t>(seconds);
+  timeout.tv_usec =
+      static_cast<suseconds_t>((seconds - timeout.tv_sec) * 1000000);
+  return setsockopt(descriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                    sizeof(timeout)) == 0;
+}
+
+/* Purpose: To send one line.
+ * Pre-conditions: line does not contain a newline.
+ * Post-conditions: Returns false if the connection is lost or the send timeout
+ *          passes. The line may then be partly sent. */
+bool LineSocket::sendLine(const string &line) {
+  string message = line + "\n";
+  size_t sent = 0;
+  while (sent < message.size()) {
+    ssize_t count = send(descriptor, message.data() + sent,
+                         message.size() - sent, sendFlags);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    sent += static_cast<size_t>(count);
+  }
+  return true;
+}
+
+/* Purpose: To read what has arrived on the socket.
+ * Pre-conditions: None.
+ * Post-conditions: Blocks until data arrives and buffers it. Returns false if
+ *          the connection was closed or lost. */
+bool LineSocket::receive() {
+  char chunk[4096];
+  ssize_t count;
+  do {
+    count = recv(descriptor, chunk, sizeof(chunk), 0);
+  } while (count < 0 && errno == EINTR);
+  if (count <= 0) {
+    return false;
+  }
+  buffer.append(chunk, static_cast<size_t>(count));
+  return true;
+}
+
+/* Purpose: To take the next complete line out of the buffer.
+ * Pre-conditions: None.
+ * Post-conditions: Returns false, leaving line alone, if the buffer does not
+ *          hold a complete line. */
+bool LineSocket::nextLine(string &line) {
+  size_t end = buffer.find('\n');
+  if (end == string::npos) {
+    return false;
+  }
+  line = buffer.substr(0, end);
+  buffer.erase(0, end + 1);
+  return true;
+}
+
+/* Purpose: To read one line.
+ * Pre-conditions: None.
+ * Post-conditions: Blocks until a line arrives. Returns false if the
+ *          connection is lost first. */
+bool LineSocket::readLine(string &line) {
+  while (!nextLine(line)) {
+    if (!receive()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Purpose: To get the socket descriptor, e.g., to poll it.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the descriptor, or -1 if closed. */
+int LineSocket::getDescriptor() const { return descriptor; }
+
+/* Purpose: To close the socket.
+ * Pre-conditions: None.
+ * Post-conditions: The socket is closed. */
+void LineSocket::close() {
+  if (descriptor >= 0) {
+    ::close(descriptor);
+    descriptor = -1;
+  }
+}
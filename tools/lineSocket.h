@@ -0,0 +1,74 @@
+/* Description: A TCP connection that sends and receives text one line at a
+ * time, used by the batch coordinator and its workers. Built on POSIX
+ * sockets. */
+#pragma once
+#if defined(_WIN32)
+#error "LineSocket uses POSIX sockets; build the batch mode on Unix."
+#endif
+#include <string>
+
+using namespace std;
+
+class LineSocket {
+public:
+  /* Purpose: Constructor to take over an open socket.
+   * Pre-conditions: descriptor is a connected socket, or -1.
+   * Post-conditions: The object closes the socket when it is destroyed. */
+  LineSocket(int descriptor = -1);
+  /* Purpose: Destructor to close the socket.
+   * Pre-conditions: None.
+   * Post-conditions: Closes the socket if it is open. */
+  ~LineSocket();
+  LineSocket(const LineSocket &) = delete;
+  LineSocket &operator=(const LineSocket &) = delete;
+
+  /* Purpose: To open a socket that accepts connections.
+   * Pre-conditions: None.
+   * Post-conditions: Returns a socket listening on port of every interface,
+   *          or -1 if the port cannot be used. */
+  static int listenOn(int port);
+  /* Purpose: To connect to a listening socket.
+   * Pre-conditions: None.
+   * Post-conditions: Returns a socket connected to host:port, or -1. */
+  static int connectTo(const string &host, int port);
+
+  /* Purpose: To bound how long a send may wait for the peer to read.
+   * Pre-conditions: seconds is positive.
+   * Post-conditions: A send that cannot go on for seconds fails. Returns
+   *          false if the timeout cannot be set. */
+  bool setSendTimeout(double seconds);
+  /* Purpose: To send one line.
+   * Pre-conditions: line does not contain a newline.
+   * Post-conditions: Returns false if the connection is lost or the send
+   *          timeout passes. The line may then be partly sent. */
+  bool sendLine(const string &line);
+  /* Purpose: To read what has arrived on the socket.
+   * Pre-conditions: None.
+   * Post-conditions: Blocks until data arrives and buffers it. Returns false
+   *          if the connection was closed or lost. */
+  bool receive();
+  /* Purpose: To take the next complete line out of the buffer.
+   * Pre-conditions: None.
+   * Post-conditions: Returns false, leaving line alone, if the buffer does
+   *          not hold a complete line. */
+  bool nextLine(string &line);
+  /* Purpose: To read one line.
+   * Pre-conditions: None.
+   * Post-conditions: Blocks until a line arrives. Returns false if the
+   *          connection is lost first. */
+  bool readLine(string &line);
+
+  /* Purpose: To get the socket descriptor, e.g., to poll it.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the descriptor, or -1 if closed. */
+  int getDescriptor() const;
+  /* Purpose: To close the socket.
+   * Pre-conditions: None.
+   * Post-conditions: The socket is closed. */
+  void close();
+
+private:
+  int descriptor;
+  /* Data received but not yet taken out as lines: */
+  string buffer;
+};
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Runs the batch mode on testImages with a coordinator and three workers on
+# this host. One worker drops out after 2 images, so its shard has to be
+# retried. Passes if every image in labels.txt gets exactly one result with
+# every column of the header.
+#
+# Usage: tools/runBatchTest.sh [batch executable] [port]
+# The executable defaults to tools/build/batch (see tools/README.md).
+TOOLS=$(dirname "$(realpath "$0")")
+BATCH=$(realpath "${1:-$TOOLS/build/batch}")
+PORT=${2:-5757}
+OUTPUT=$(mktemp)
+
+cd "$TOOLS/../testImages" || exit 1
+
+"$BATCH" coordinator "$PORT" labels.txt "$OUTPUT" 2 &
+COORDINATOR=$!
+"$BATCH" worker localhost "$PORT" cottonMaskFV.jpg reference 2 &
+"$BATCH" worker localhost "$PORT" cottonMaskFV.jpg reference &
+"$BATCH" worker localhost "$PORT" cottonMaskFV.jpg simd &
+wait "$COORDINATOR"
+STATUS=$?
+wait
+
+EXPECTED=$(grep -c . labels.txt)
+RESULTS=$(tail -n +2 "$OUTPUT" | wc -l)
+IMAGES=$(tail -n +2 "$OUTPUT" | cut -f1 | sort -u | wc -l)
+SHORT=$(awk -F '\t' 'NF != 9' "$OUTPUT" | wc -l)
+cat "$OUTPUT"
+rm -f "$OUTPUT"
+
+if [ "$STATUS" -ne 0 ] || [ "$RESULTS" -ne "$EXPECTED" ] ||
+   [ "$IMAGES" -ne "$EXPECTED" ] || [ "$SHORT" -ne 0 ]; then
+  echo "FAILED: $RESULTS results for $IMAGES of $EXPECTED images," \
+    "$SHORT without 9 columns"
+  exit 1
+fi
+echo "PASSED: $EXPECTED images"
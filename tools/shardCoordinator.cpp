@@ -0,0 +1,272 @@
+/* Description: The coordinator of the batch mode. Splits a manifest of images
+ * into shards and hands them to the workers that connect over TCP. Results
+ * of a shard are kept until the worker finishes it, then appended to one
+ * output file, so a worker that dies part way never leaves partial or
+ * duplicate results. Its shard is retried by another worker. So is the shard
+ * of a worker that stops reading: sends time out instead of blocking the
+ * coordinator. Workers that say HELLO with a name already taken get "#n"
+ * appended, so each connection has its own throughput row. */
+#include "shardCoordinator.h"
+#include <cerrno>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+
+/* Purpose: Constructor to split the images into shards.
+ * Pre-conditions: shardSize and maxAttempts are positive.
+ * Post-conditions: Creates a coordinator with every shard waiting. */
+ShardCoordinator::ShardCoordinator(const vector<string> &images,
+                                   int shardSize, int maxAttempts,
+                                   double shardTimeoutSeconds)
+    : finished(0), failed(0), maxAttempts(maxAttempts),
+      shardTimeoutSeconds(shardTimeoutSeconds), wallSeconds(0) {
+  for (size_t first = 0; first < images.size(); first += shardSize) {
+    Shard shard;
+    size_t last = min(images.size(), first + shardSize);
+    shard.images.assign(images.begin() + first, images.begin() + last);
+    waiting.push_back(static_cast<int>(shards.size()));
+    shards.push_back(shard);
+  }
+}
+
+/* Purpose: To hand out every shard and merge the results.
+ * Pre-conditions: None.
+ * Post-conditions: Serves workers on port until every shard is finished or
+ *          has failed maxAttempts times, writing one line per image to
+ *          outputFile with the 9 tab-separated columns of its header. An image
+ *          that could not be matched has "error" as found and empty numbers.
+ *          Returns false if the port or file cannot be opened or a shard
+ *          failed. */
+bool ShardCoordinator::run(int port, const string &outputFile) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  LineSocket listener(LineSocket::listenOn(port));
+  if (listener.getDescriptor() < 0) {
+    cout << "Could not listen on port " << port << endl;
+    return false;
+  }
+  output.open(outputFile);
+  if (!output) {
+    cout << "Could not write " + outputFile << endl;
+    return false;
+  }
+  output << "image\tfound\tratio\tms\tx\ty\twidth\theight\tworker" << endl;
+
+  while (finished < static_cast<int>(shards.size())) {
+    /* Wait for a new worker or a line from a connected one: */
+    vector<pollfd> descriptors;
+    descriptors.push_back({listener.getDescriptor(), POLLIN, 0});
+    for (Connection &connection : connections) {
+      descriptors.push_back({connection.socket.getDescriptor(), POLLIN, 0});
+    }
+    if (poll(descriptors.data(), descriptors.size(), 1000) < 0 &&
+        errno != EINTR) {
+      cout << "Could not wait for workers" << endl;
+      return false;
+    }
+
+    /* Read from the workers that were polled. A worker accepted below is
+     * at the end of the list, past the polled ones: */
+    list<Connection>::iterator it = connections.begin();
+    for (size_t i = 1; i < descriptors.size(); ++i) {
+      Connection &connection = *it;
+      bool alive = true;
+      if (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        alive = connection.socket.receive();
+        string line;
+        while (alive && connection.socket.nextLine(line)) {
+          alive = handleLine(connection, line);
+        }
+      }
+
+      /* A worker that hangs on a shard is treated as dead: */
+      if (alive && connection.shard >= 0 &&
+          chrono::duration<double>(chrono::steady_clock::now() -
+                                   connection.assigned)
+                  .count() > shardTimeoutSeconds) {
+        cout << "Worker " << connection.name << " timed out" << endl;
+        alive = false;
+      }
+
+      if (alive) {
+        ++it;
+      } else {
+        dropWorker(connection);
+        it = connections.erase(it);
+      }
+    }
+
+    if (descriptors[0].revents & POLLIN) {
+      int descriptor = accept(listener.getDescriptor(), nullptr, nullptr);
+      if (descriptor >= 0) {
+        connections.emplace_back(descriptor);
+        connections.back().socket.setSendTimeout(sendTimeoutSeconds);
+      }
+    }
+
+    assignShards();
+  }
+
+  /* Tell the workers still connected that the batch is done: */
+  assignShards();
+  connections.clear();
+  output.close();
+  wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start)
+                    .count();
+  return failed == 0;
+}
+
+/* Purpose: To act on a line from a worker.
+ * Pre-conditions: None.
+ * Post-conditions: Returns false if the worker broke the protocol. */
+bool ShardCoordinator::handleLine(Connection &connection,
+                                  const string &line) {
+  istringstream fields(line);
+  string command;
+  fields >> command;
+
+  if (command == "HELLO" && connection.name.empty()) {
+    string name;
+    fields >> name;
+    if (name.empty()) {
+      return false;
+    }
+
+    /* Two workers with one name would share a throughput row, so number
+     * every name after the first: */
+    connection.name = name;
+    for (int copy = 2; throughput.count(connection.name) > 0; ++copy) {
+      connection.name = name + "#" + to_string(copy);
+    }
+    throughput[connection.name];
+    cout << "Worker " << connection.name << " connected" << endl;
+    return true;
+  }
+
+  if (command == "RESULT" && connection.shard >= 0 &&
+      line.size() > command.size()) {
+    connection.results.push_back(line.substr(command.size() + 1) + "\t" +
+                                 connection.name);
+    return true;
+  }
+
+  int shard = -1;
+  if (command == "SHARD_DONE" && fields >> shard && shard >= 0 &&
+      shard == connection.shard &&
+      connection.results.size() == shards[shard].images.size()) {
+    /* The shard is complete, so its results can join the output: */
+    for (const string &result : connection.results) {
+      output << result << "\n";
+    }
+    output.flush();
+
+    WorkerThroughput &worker = throughput[connection.name];
+    worker.shards++;
+    worker.images += static_cast<int>(connection.results.size());
+    worker.busySeconds += chrono::duration<double>(
+                              chrono::steady_clock::now() -
+                              connection.assigned)
+                              .count();
+    connection.shard = -1;
+    connection.results.clear();
+    finished++;
+    return true;
+  }
+
+  return false;
+}
+
+/* Purpose: To give waiting shards to workers without one.
+ * Pre-conditions: None.
+ * Post-conditions: Sends shards, or DONE once every shard is finished. A
+ *          worker a send fails to is dropped and its shard requeued. */
+void ShardCoordinator::assignShards() {
+  list<Connection>::iterator it = connections.begin();
+  while (it != connections.end()) {
+    Connection &connection = *it;
+    if (connection.name.empty() || connection.shard >= 0) {
+      ++it;
+      continue;
+    }
+
+    bool sent = true;
+    if (finished == static_cast<int>(shards.size())) {
+      sent = connection.socket.sendLine("DONE");
+    } else if (!waiting.empty()) {
+      int shard = waiting.front();
+      waiting.pop_front();
+      shards[shard].attempts++;
+      connection.shard = shard;
+      connection.assigned = chrono::steady_clock::now();
+
+      sent = connection.socket.sendLine(
+          "SHARD " + to_string(shard) + " " +
+          to_string(shards[shard].images.size()));
+      for (size_t i = 0; sent && i < shards[shard].images.size(); ++i) {
+        sent = connection.socket.sendLine(shards[shard].images[i]);
+      }
+    }
+    /* Otherwise the worker idles until a shard is retried or the batch is
+     * done. */
+
+    /* A worker that is gone or stopped reading cannot finish the shard, so
+     * it goes back to the queue: */
+    if (sent) {
+      ++it;
+    } else {
+      dropWorker(connection);
+      it = connections.erase(it);
+    }
+  }
+}
+
+/* Purpose: To forget a worker that died or broke the protocol.
+ * Pre-conditions: None.
+ * Post-conditions: Its shard waits for another worker, or fails if it has
+ *          been tried maxAttempts times. */
+void ShardCoordinator::dropWorker(Connection &connection) {
+  cout << "Lost worker " << connection.name << endl;
+  int shard = connection.shard;
+  if (shard < 0) {
+    return;
+  }
+  throughput[connection.name].lostShards++;
+
+  if (shards[shard].attempts < maxAttempts) {
+    /* Retry the shard before the ones never tried: */
+    cout << "Retrying shard " << shard << endl;
+    waiting.push_front(shard);
+    return;
+  }
+
+  /* Give up on the shard, but still give every image a line with every
+   * column of the header. No worker finished it: */
+  cout << "Shard " << shard << " failed " << maxAttempts << " times" << endl;
+  for (const string &image : shards[shard].images) {
+    output << image << "\terror\t\t\t\t\t\t\t-\n";
+  }
+  output.flush();
+  finished++;
+  failed++;
+}
+
+/* Purpose: To print the throughput of every worker.
+ * Pre-conditions: run() has been called.
+ * Post-conditions: Outputs the report to the window. */
+void ShardCoordinator::printThroughput() const {
+  cout << "worker | shards images lost | images/s" << endl;
+  cout << fixed << setprecision(2);
+  int images = 0;
+  for (const pair<const string, WorkerThroughput> &entry : throughput) {
+    const WorkerThroughput &worker = entry.second;
+    images += worker.images;
+    cout << entry.first << " | " << worker.shards << " " << worker.images
+         << " " << worker.lostShards << " | "
+         << (worker.busySeconds > 0 ? worker.images / worker.busySeconds : 0)
+         << endl;
+  }
+  cout << "Total: " << images << " images in " << wallSeconds << " s ("
+       << (wallSeconds > 0 ? images / wallSeconds : 0) << " images/s), "
+       << failed << " failed shards" << endl;
+}
@@ -0,0 +1,104 @@
+/* Description: The coordinator of the batch mode. Splits a manifest of images
+ * into shards and hands them to the workers that connect over TCP. Results
+ * of a shard are kept until the worker finishes it, then appended to one
+ * output file, so a worker that dies part way never leaves partial or
+ * duplicate results. Its shard is retried by another worker. So is the shard
+ * of a worker that stops reading: sends time out instead of blocking the
+ * coordinator. Workers that say HELLO with a name already taken get "#n"
+ * appended, so each connection has its own throughput row.
+ *
+ * Protocol, one line per message:
+ *   worker:      HELLO <name>
+ *   coordinator: SHARD <id> <count>, then count image paths, or DONE
+ *   worker:      RESULT <result line> for every image, then SHARD_DONE <id> */
+#pragma once
+#include "lineSocket.h"
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Structure that stores the throughput of one worker: */
+struct WorkerThroughput {
+  int shards = 0;
+  int images = 0;
+  /* Shards the worker took but never finished: */
+  int lostShards = 0;
+  /* Time from handing the worker a shard to it finishing the shard: */
+  double busySeconds = 0;
+};
+
+class ShardCoordinator {
+public:
+  /* Purpose: Constructor to split the images into shards.
+   * Pre-conditions: shardSize and maxAttempts are positive.
+   * Post-conditions: Creates a coordinator with every shard waiting. */
+  ShardCoordinator(const vector<string> &images, int shardSize,
+                   int maxAttempts = 3, double shardTimeoutSeconds = 600);
+
+  /* Purpose: To hand out every shard and merge the results.
+   * Pre-conditions: None.
+   * Post-conditions: Serves workers on port until every shard is finished
+   *          or has failed maxAttempts times, writing one line per image to
+   *          outputFile with the 9 tab-separated columns of its header. An
+   *          image that could not be matched has "error" as found and empty
+   *          numbers. Returns false if the port or file cannot be opened or
+   *          a shard failed. */
+  bool run(int port, const string &outputFile);
+  /* Purpose: To print the throughput of every worker.
+   * Pre-conditions: run() has been called.
+   * Post-conditions: Outputs the report to the window. */
+  void printThroughput() const;
+
+private:
+  /* Structure that stores a shard and its retries: */
+  struct Shard {
+    vector<string> images;
+    int attempts = 0;
+  };
+  /* Structure that stores a connected worker: */
+  struct Connection {
+    Connection(int descriptor) : socket(descriptor) {}
+    LineSocket socket;
+    /* Name the worker said HELLO with, empty before then: */
+    string name;
+    /* Shard the worker is on, or -1, and its results so far: */
+    int shard = -1;
+    vector<string> results;
+    chrono::steady_clock::time_point assigned;
+  };
+
+  /* Purpose: To act on a line from a worker.
+   * Pre-conditions: None.
+   * Post-conditions: Returns false if the worker broke the protocol. */
+  bool handleLine(Connection &connection, const string &line);
+  /* Purpose: To give waiting shards to workers without one.
+   * Pre-conditions: None.
+   * Post-conditions: Sends shards, or DONE once every shard is finished. A
+   *          worker a send fails to is dropped and its shard requeued. */
+  void assignShards();
+  /* Purpose: To forget a worker that died or broke the protocol.
+   * Pre-conditions: None.
+   * Post-conditions: Its shard waits for another worker, or fails if it
+   *          has been tried maxAttempts times. */
+  void dropWorker(Connection &connection);
+
+  vector<Shard> shards;
+  deque<int> waiting;
+  int finished;
+  int failed;
+  int maxAttempts;
+  double shardTimeoutSeconds;
+  /* Longest a send to a worker that stopped reading may block: */
+  const double sendTimeoutSeconds = 10;
+
+  list<Connection> connections;
+  ofstream output;
+  map<string, WorkerThroughput> throughput;
+  double wallSeconds;
+};
@@ -0,0 +1,140 @@
+/* Description: A worker of the batch mode. Keeps one prepared
+ * ObjectRecognition model for its whole life and matches every image of the
+ * shards the coordinator hands it, sending back one result line per image. */
+#include "shardWorker.h"
+#include "helperFunctions.hpp"
+#include <thread>
+
+/* Purpose: Constructor to create a worker without a model.
+ * Pre-conditions: None.
+ * Post-conditions: Creates a worker that reports itself as name. */
+ShardWorker::ShardWorker(const string &name)
+    : model(nullptr), name(name), images(0) {}
+
+/* Purpose: Destructor to remove dynamic memory.
+ * Pre-conditions: None.
+ * Post-conditions: Deletes the model. */
+ShardWorker::~ShardWorker() { delete model; }
+
+/* Purpose: To prepare the model once for every shard.
+ * Pre-conditions: None.
+ * Post-conditions: Loads the exemplar and builds its transformation space,
+ *          scoring with backend. Returns false if the exemplar cannot be read
+ *          or there is no such backend. */
+bool ShardWorker::prepare(const string &exemplarFile, const string &backend) {
+  /* Read in, edge-detect and crop the exemplar: */
+  Mat edgedEx;
+  Mat originalEx;
+  if (!loadExemplar(exemplarFile, edgedEx, originalEx)) {
+    return false;
+  }
+
+  delete model;
+  model = new ObjectRecognition(edgedEx);
+  if (!model->setMatcherBackend(backend)) {
+    cout << "Unknown backend " + backend << endl;
+    return false;
+  }
+  model->transformationSpace();
+  return true;
+}
+
+/* Purpose: To work on shards until the coordinator is done.
+ * Pre-conditions: prepare() has succeeded.
+ * Post-conditions: Returns true once the coordinator says the batch is done,
+ *          or false if it cannot be reached or the connection is lost. With
+ *          failAfter of 0 or more, the worker drops the connection after that
+ *          many images, as if it had died. */
+bool ShardWorker::run(const string &host, int port, int failAfter) {
+  /* Give the coordinator a few seconds to start: */
+  int descriptor = -1;
+  for (int attempt = 0; attempt < 20 && descriptor < 0; ++attempt) {
+    descriptor = LineSocket::connectTo(host, port);
+    if (descriptor < 0) {
+      this_thread::sleep_for(chrono::milliseconds(250));
+    }
+  }
+  LineSocket socket(descriptor);
+  if (descriptor < 0 || !socket.sendLine("HELLO " + name)) {
+    cout << "Could not reach the coordinator at " << host << ":" << port
+         << endl;
+    return false;
+  }
+
+  string line;
+  while (socket.readLine(line)) {
+    if (line == "DONE") {
+      return true;
+    }
+
+    /* Read in the paths of the shard: */
+    istringstream fields(line);
+    string command;
+    int shard = -1;
+    int count = 0;
+    if (!(fields >> command >> shard >> count) || command != "SHARD" ||
+        count < 0 || count > maxShardImages) {
+      cout << "Unexpected message from the coordinator: " << line << endl;
+      return false;
+    }
+    vector<string> paths(count);
+    for (string &path : paths) {
+      if (!socket.readLine(path)) {
+        return false;
+      }
+    }
+
+    for (const string &path : paths) {
+      if (failAfter >= 0 && images >= failAfter) {
+        cout << "Worker " << name << " stopping after " << images
+             << " images" << endl;
+        socket.close();
+        return false;
+      }
+      if (!socket.sendLine("RESULT " + matchImage(path))) {
+        return false;
+      }
+    }
+    if (!socket.sendLine("SHARD_DONE " + to_string(shard))) {
+      return false;
+    }
+  }
+  return false;
+}
+
+/* Purpose: To get the number of images matched.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the number of images matched so far. */
+int ShardWorker::getImages() const { return images; }
+
+/* Purpose: To match one image of a shard.
+ * Pre-conditions: None.
+ * Post-conditions: Returns the result line of the image: its path, then
+ *          found, ratio, ms and the match box, separated by tabs. If the
+ *          image cannot be read, found is "error" and the rest are empty. */
+string ShardWorker::matchImage(const string &path) {
+  images++;
+  Mat original = imread(path);
+  if (original.empty()) {
+    cout << "Could not read " + path << endl;
+    return path + "\terror\t\t\t\t\t\t";
+  }
+
+  /* Edge-detect and crop the image, then match it with the prepared model,
+   * silencing its per-image output: */
+  Mat edges = original.clone();
+  readImage(edges, path);
+  EdgeStats stats = trimImage(edges, original);
+  ostringstream silenced;
+  streambuf *console = cout.rdbuf(silenced.rdbuf());
+  model->match(edges, original, path, &stats);
+  cout.rdbuf(console);
+
+  const MatchResult &result = model->getLastResult();
+  ostringstream line;
+  line << path << "\t" << (result.found ? 1 : 0) << "\t" << result.ratio
+       << "\t" << result.elapsedMs << "\t" << result.box.x << "\t"
+       << result.box.y << "\t" << result.box.width << "\t"
+       << result.box.height;
+  return line.str();
+}
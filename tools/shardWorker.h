@@ -0,0 +1,56 @@
+/* Description: A worker of the batch mode. Keeps one prepared
+ * ObjectRecognition model for its whole life and matches every image of the
+ * shards the coordinator hands it, sending back one result line per image. */
+#pragma once
+#include "lineSocket.h"
+#include "objectRecognition.h"
+
+class ShardWorker {
+public:
+  /* Purpose: Constructor to create a worker without a model.
+   * Pre-conditions: None.
+   * Post-conditions: Creates a worker that reports itself as name. */
+  ShardWorker(const string &name);
+  /* Purpose: Destructor to remove dynamic memory.
+   * Pre-conditions: None.
+   * Post-conditions: Deletes the model. */
+  ~ShardWorker();
+  ShardWorker(const ShardWorker &) = delete;
+  ShardWorker &operator=(const ShardWorker &) = delete;
+
+  /* Purpose: To prepare the model once for every shard.
+   * Pre-conditions: None.
+   * Post-conditions: Loads the exemplar and builds its transformation
+   *          space, scoring with backend. Returns false if the exemplar
+   *          cannot be read or there is no such backend. */
+  bool prepare(const string &exemplarFile, const string &backend);
+
+  /* Purpose: To work on shards until the coordinator is done.
+   * Pre-conditions: prepare() has succeeded.
+   * Post-conditions: Returns true once the coordinator says the batch is
+   *          done, or false if it cannot be reached or the connection is
+   *          lost. With failAfter of 0 or more, the worker drops the
+   *          connection after that many images, as if it had died. */
+  bool run(const string &host, int port, int failAfter = -1);
+  /* Purpose: To get the number of images matched.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the number of images matched so far. */
+  int getImages() const;
+
+  /* Most images a shard may hold. A larger count from the coordinator is
+   * treated as a broken protocol: */
+  static const int maxShardImages = 4096;
+
+private:
+  /* Purpose: To match one image of a shard.
+   * Pre-conditions: None.
+   * Post-conditions: Returns the result line of the image: its path, then
+   *          found, ratio, ms and the match box, separated by tabs. If the
+   *          image cannot be read, found is "error" and the rest are empty.
+   */
+  string matchImage(const string &path);
+
+  ObjectRecognition *model;
+  string name;
+  int images;
+};
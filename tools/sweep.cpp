@@ -0,0 +1,151 @@
+/* Description: Runs a grid of search profiles over a labelled image set and
+ * reports the accuracy of each profile next to the probes and milliseconds it
+ * spends per image, marking the profiles on the accuracy/speed Pareto front.
+ *
+ * Usage: sweep [exemplar] [image directory] [labels file]
+ * The labels file has one "<image file> <1 if wearing a mask, else 0>" per
+ * line, e.g., testImages/labels.txt. */
+#include "helperFunctions.hpp"
+#include <chrono>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+/* Structure that stores the measurements of one profile: */
+struct SweepRow {
+  SearchProfile profile;
+  double accuracy;
+  double probesPerImage;
+  double msPerImage;
+  bool pareto;
+};
+
+/* Purpose: To build the grid of profiles to sweep.
+ * Pre-conditions: None.
+ * Post-conditions: Returns every combination of the swept parameters, with
+ *          the other parameters at their defaults. */
+vector<SearchProfile> profileGrid() {
+  vector<SearchProfile> grid;
+  for (double incrementScale : {0.10, 0.20}) {
+    for (int incrementRotation : {60, 90}) {
+      for (int gridStride : {25, 50}) {
+        for (double translationDensity : {0.05, 0.10}) {
+          for (double boundFactor : {0.15, 0.20}) {
+            SearchProfile profile;
+            profile.incrementScale = incrementScale;
+            profile.incrementRotation = incrementRotation;
+            profile.gridStride = gridStride;
+            profile.translationDensity = translationDensity;
+            profile.sparseBoundFactor = boundFactor;
+            profile.denseBoundFactor = boundFactor + 0.05;
+            grid.push_back(profile);
+          }
+        }
+      }
+    }
+  }
+  return grid;
+}
+
+/* Purpose: To measure one profile on the labelled images.
+ * Pre-conditions: edgedEx is the cropped edge-detected exemplar.
+ * Post-conditions: Returns the accuracy, probes and time of the profile. */
+SweepRow runProfile(const Mat &edgedEx, const SearchProfile &profile,
+                    vector<LabelledImage> &images) {
+  ObjectRecognition model(edgedEx, profile);
+  model.transformationSpace();
+
+  /* Silence the per-image results while measuring: */
+  ostringstream silenced;
+  streambuf *console = cout.rdbuf(silenced.rdbuf());
+
+  int correct = 0;
+  long long probes = 0;
+  double milliseconds = 0;
+  for (LabelledImage &image : images) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool found = model.match(image.edges, image.original, image.name,
+                             &image.stats);
+    milliseconds += chrono::duration<double, milli>(
+                        chrono::steady_clock::now() - start)
+                        .count();
+    probes += model.getLastResult().probes;
+    if (found == image.mask) {
+      correct++;
+    }
+  }
+  cout.rdbuf(console);
+
+  SweepRow row;
+  row.profile = profile;
+  row.accuracy = correct / static_cast<double>(images.size());
+  row.probesPerImage = probes / static_cast<double>(images.size());
+  row.msPerImage = milliseconds / images.size();
+  row.pareto = false;
+  return row;
+}
+
+/* Purpose: To mark the profiles on the accuracy/speed Pareto front.
+ * Pre-conditions: None.
+ * Post-conditions: A row is marked if no other row is at least as accurate
+ *          and at least as fast while being better in one of them. */
+void markParetoFront(vector<SweepRow> &rows) {
+  for (SweepRow &row : rows) {
+    row.pareto = true;
+    for (const SweepRow &other : rows) {
+      bool asGood = other.accuracy >= row.accuracy &&
+                    other.msPerImage <= row.msPerImage;
+      bool better = other.accuracy > row.accuracy ||
+                    other.msPerImage < row.msPerImage;
+      if (asGood && better) {
+        row.pareto = false;
+        break;
+      }
+    }
+  }
+}
+
+/* Purpose: Sweep the profile grid and print the results.
+ * Pre-conditions: The exemplar and labelled images can be read.
+ * Post-conditions: Prints one row per profile. */
+int main(int argc, char *argv[]) {
+  string exemplarFile = argc > 1 ? argv[1] : "cottonMaskFV.jpg";
+  string directory = argc > 2 ? argv[2] : ".";
+  string labelsFile = argc > 3 ? argv[3] : directory + "/labels.txt";
+
+  /* Read in, edge-detect and crop the exemplar: */
+  Mat edgedEx;
+  Mat originalEx;
+  if (!loadExemplar(exemplarFile, edgedEx, originalEx)) {
+    return 1;
+  }
+
+  vector<LabelledImage> images = readLabelledImages(directory, labelsFile);
+  if (images.empty()) {
+    cout << "No labelled images in " + labelsFile << endl;
+    return 1;
+  }
+
+  /* Measure every profile: */
+  vector<SweepRow> rows;
+  for (const SearchProfile &profile : profileGrid()) {
+    rows.push_back(runProfile(edgedEx, profile, images));
+  }
+  markParetoFront(rows);
+
+  /* Print the results: */
+  cout << "scaleInc rotInc stride density bound | accuracy probes/img ms/img"
+       << endl;
+  cout << fixed << setprecision(2);
+  for (const SweepRow &row : rows) {
+    cout << setw(8) << row.profile.incrementScale << " " << setw(6)
+         << row.profile.incrementRotation << " " << setw(6)
+         << row.profile.gridStride << " " << setw(7)
+         << row.profile.translationDensity << " " << setw(5)
+         << row.profile.sparseBoundFactor << " | " << setw(8) << row.accuracy
+         << " " << setw(10) << row.probesPerImage << " " << setw(6)
+         << row.msPerImage << (row.pareto ? "  *pareto" : "") << endl;
+  }
+  return 0;
+}